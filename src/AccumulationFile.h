@@ -0,0 +1,82 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "TemporaryPath.h"
+
+// Raw accumulation buffer on disk: per pixel running sums and sample counts exactly as the RGBA32F
+// target holds them, so buffers rendered by different processes can be merged without loss.
+//
+//	"CLRACC01", then uint32 width, height, sampleOffset, sampleCount, then width * height * 4 floats.
+struct AccumulationFile {
+	unsigned int width = 0, height = 0;
+	// The buffer holds sample indices [sampleOffset, sampleOffset + sampleCount).
+	unsigned int sampleOffset = 0, sampleCount = 0;
+	// RGBA per pixel, bottom row first: rgb sum, alpha sample count.
+	std::vector<float> pixels;
+
+	// Written next to the destination and renamed into place, so readers never see a partial file.
+	bool Write(const std::string& path) const {
+		std::string temporaryPath = GetTemporaryPath(path);
+		std::ofstream file = std::ofstream(temporaryPath, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write accumulation <" << temporaryPath << ">" << std::endl;
+			return false;
+		}
+		uint32_t header[4] = { width, height, sampleOffset, sampleCount };
+		file.write(Magic(), 8);
+		file.write((const char*)header, sizeof(header));
+		file.write((const char*)pixels.data(), pixels.size() * sizeof(float));
+		file.close();
+		if (file.fail()) {
+			std::cout << "ERROR: Could not write accumulation <" << temporaryPath << ">" << std::endl;
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+		// rename() does not replace an existing file on Windows. Elsewhere it replaces it atomically, so
+		// readers see either the old file or the new one.
+#if defined(_MSC_VER)
+		std::remove(path.c_str());
+#endif
+		if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+			std::remove(temporaryPath.c_str());
+			std::cout << "ERROR: Could not move accumulation into place at <" << path << ">" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	bool Read(const std::string& path) {
+		std::ifstream file = std::ifstream(path, std::ios::binary);
+		if (!file.is_open()) return false;
+
+		char magic[8];
+		uint32_t header[4];
+		file.read(magic, 8);
+		file.read((char*)header, sizeof(header));
+		if (!file || memcmp(magic, Magic(), 8) != 0) {
+			std::cout << "ERROR: <" << path << "> is not an accumulation file" << std::endl;
+			return false;
+		}
+		width = header[0];
+		height = header[1];
+		sampleOffset = header[2];
+		sampleCount = header[3];
+
+		pixels.resize((size_t)width * height * 4);
+		file.read((char*)pixels.data(), pixels.size() * sizeof(float));
+		if (!file) {
+			std::cout << "ERROR: Accumulation file <" << path << "> is truncated" << std::endl;
+			return false;
+		}
+		return true;
+	}
+private:
+	static const char* Magic() {
+		return "CLRACC01";
+	}
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstring>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Texture.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+// Loads assets without holding up the render thread, so the first frame can go out with placeholders.
+// Files are decoded, or mapped from their cache, on a WorkerPool. Update(), called once a frame on the
+// GL thread, streams the levels into their textures through a pixel unpack buffer, at most uploadBudget bytes per call, and
+// hands each texture to its callback once it is complete.
+class AssetLoader {
+public:
+	// Runs on the GL thread inside Update().
+	typedef std::function<void(std::unique_ptr<Texture> texture)> TextureCallback;
+	// Enough to upload a 4K RGB32F environment map in a dozen frames without a visible hitch.
+	static const size_t DEFAULT_UPLOAD_BUDGET = 16 << 20;
+public:
+	AssetLoader(size_t uploadBudget = DEFAULT_UPLOAD_BUDGET) {
+		this->uploadBudget = uploadBudget;
+	}
+	// Waits for decodes in progress; loads not yet delivered are dropped without running their callbacks.
+	~AssetLoader() {
+		workers.Wait();
+		for (std::unique_ptr<Upload>& upload : uploads) DeleteBuffer(*upload);
+	}
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// A failed load prints an error and never calls back, leaving the caller with its placeholder.
+	void LoadEnvironmentMap(const std::string& path, EnvironmentFormat format, TextureCallback callback) {
+		pendingCount++;
+		workers.Submit([this, path, format, callback]() {
+			PROFILE_ZONE("Decode environment map");
+			std::unique_ptr<Upload> upload(new Upload());
+			upload->callback = callback;
+			upload->decoded = EnvironmentCache::Load(path, format, upload->data);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(std::move(upload));
+		});
+	}
+	// GL thread only.
+	void Update() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (std::unique_ptr<Upload>& upload : decoded) uploads.push_back(std::move(upload));
+			decoded.clear();
+		}
+		if (uploads.empty()) return;
+
+		PROFILE_ZONE("Asset uploads");
+		size_t budget = uploadBudget;
+		while (!uploads.empty() && budget) {
+			Upload& upload = *uploads.front();
+			if (upload.decoded && !UploadRows(upload, budget)) return;
+
+			if (upload.decoded) upload.callback(std::move(upload.texture));
+			DeleteBuffer(upload);
+			uploads.pop_front();
+			pendingCount--;
+		}
+	}
+	// Blocks until every load has been delivered, for callers that cannot start out with placeholders.
+	void Finish() {
+		workers.Wait();
+		while (!IsIdle()) Update();
+	}
+	// True once every load has been delivered or has failed.
+	bool IsIdle() {
+		return pendingCount == 0;
+	}
+	// A 1x1 environment map of constant radiance, to render with until the real one is in.
+	static std::unique_ptr<Texture> CreatePlaceholderEnvironmentMap(glm::vec3 radiance) {
+		std::unique_ptr<Texture> texture(new Texture(1, 1, 1, GL_RGB32F, GL_CLAMP_TO_EDGE));
+		glTextureSubImage2D(texture->GetID(), 0, 0, 0, 1, 1, GL_RGB, GL_FLOAT, &radiance);
+		return texture;
+	}
+private:
+	struct Upload {
+		TextureCallback callback;
+		bool decoded = false;
+		EnvironmentMapData data;
+
+		std::unique_ptr<Texture> texture;
+		GLuint buffer = 0;
+		void* mapped = nullptr;
+		// The level being uploaded, where it starts in the buffer and its rows already handed to the texture.
+		size_t level = 0;
+		size_t levelOffset = 0;
+		int uploadedRows = 0;
+	};
+
+	size_t uploadBudget;
+	// Decoded on a worker, waiting for the GL thread.
+	std::vector<std::unique_ptr<Upload>> decoded;
+	std::mutex mutex;
+	// GL thread only, uploaded in order.
+	std::deque<std::unique_ptr<Upload>> uploads;
+	unsigned int pendingCount = 0;
+
+	WorkerPool workers;
+private:
+	// Copies rows through the unpack buffer, level by level, until budget runs out. True once the
+	// texture is complete.
+	bool UploadRows(Upload& upload, size_t& budget) {
+		EnvironmentMapData& data = upload.data;
+		if (!upload.texture) {
+			upload.texture.reset(new Texture(data.levels[0].width, data.levels[0].height, (int)data.levels.size(), data.GetInternalFormat(), GL_CLAMP_TO_EDGE));
+			size_t size = 0;
+			for (const EnvironmentMapData::Level& level : data.levels) size += level.size;
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glCreateBuffers(1, &upload.buffer);
+			glNamedBufferStorage(upload.buffer, size, nullptr, flags);
+			upload.mapped = glMapNamedBufferRange(upload.buffer, 0, size, flags);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+		do {
+			const EnvironmentMapData::Level& level = data.levels[upload.level];
+			// Compressed levels go in whole rows of blocks, and at least one of those per call, however small the budget.
+			int granularity = data.GetRowGranularity();
+			size_t rowSize = data.GetRowSize(upload.level);
+			size_t remaining = (level.height - upload.uploadedRows + granularity - 1) / granularity;
+			size_t count = std::min(remaining, std::max((size_t)1, budget / rowSize));
+			int rowCount = std::min((int)count * granularity, level.height - upload.uploadedRows);
+			size_t sourceOffset = rowSize * (upload.uploadedRows / granularity);
+			size_t offset = upload.levelOffset + sourceOffset;
+			memcpy((char*)upload.mapped + offset, level.data + sourceOffset, rowSize * count);
+			data.UploadRows(upload.texture->GetID(), upload.level, upload.uploadedRows, rowCount, (void*)offset);
+
+			upload.uploadedRows += rowCount;
+			budget -= std::min(budget, rowSize * count);
+			if (upload.uploadedRows == level.height) {
+				upload.levelOffset += level.size;
+				upload.level++;
+				upload.uploadedRows = 0;
+			}
+		} while (budget && upload.level < data.levels.size());
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return upload.level == data.levels.size();
+	}
+	// The copies already queued keep the buffer alive until they are done.
+	static void DeleteBuffer(Upload& upload) {
+		if (!upload.buffer) return;
+		glUnmapNamedBuffer(upload.buffer);
+		glDeleteBuffers(1, &upload.buffer);
+		upload.buffer = 0;
+		upload.mapped = nullptr;
+		upload.data.Release();
+	}
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+// CPU encoder for unsigned BC6H (GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT). Every block uses mode 11:
+// one region, 10 bit endpoints stored as they are and 4 bit indices. That gives up the partitioned
+// modes, which help on sharp two-colour edges, but a sky is smooth and the encoder stays simple and
+// fast. Like the hardware, the encoder works on half float bit patterns, which BC6H interpolates
+// as integers.
+namespace BC6H {
+	static const size_t BLOCK_BYTES = 16;
+	// Largest half float bit pattern an unsigned block can reproduce, 65504.
+	static const int MAX_HALF = 0x7BFF;
+	static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline size_t GetSize(int width, int height) {
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BLOCK_BYTES;
+	}
+	inline int Unquantize(int endpoint) {
+		if (endpoint == 0) return 0;
+		if (endpoint == 1023) return 0xFFFF;
+		return ((endpoint << 16) + 0x8000) >> 10;
+	}
+	// The 10 bit endpoint that decodes closest to a half bit pattern.
+	inline int Quantize(float half) {
+		int endpoint = (int)std::floor((half * 64.0f / 31.0f - 32.0f) / 64.0f + 0.5f);
+		return std::min(std::max(endpoint, 0), 1023);
+	}
+	// What the decoder makes of endpoints a and b at every index, as half bit patterns.
+	inline void GetPalette(const int a[3], const int b[3], int palette[16][3]) {
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 3; c++) {
+				int interpolated = (Unquantize(a[c]) * (64 - WEIGHTS[i]) + Unquantize(b[c]) * WEIGHTS[i] + 32) >> 6;
+				palette[i][c] = (interpolated * 31) >> 6;
+			}
+		}
+	}
+	// Picks the closest palette entry for every texel; returns the total squared error.
+	inline float FitIndices(const float texels[16][3], const int a[3], const int b[3], int indices[16]) {
+		int palette[16][3];
+		GetPalette(a, b, palette);
+		float totalError = 0.0f;
+		for (int t = 0; t < 16; t++) {
+			float bestError = 1e30f;
+			for (int i = 0; i < 16; i++) {
+				float error = 0.0f;
+				for (int c = 0; c < 3; c++) {
+					float difference = texels[t][c] - (float)palette[i][c];
+					error += difference * difference;
+				}
+				if (error < bestError) {
+					bestError = error;
+					indices[t] = i;
+				}
+			}
+			totalError += bestError;
+		}
+		return totalError;
+	}
+	// Least squares endpoints for fixed indices, which usually pulls them off the candidate line
+	// towards texels it missed. False if every texel uses the same index.
+	inline bool RefitEndpoints(const float texels[16][3], const int indices[16], int a[3], int b[3]) {
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[3] = {}, bx[3] = {};
+		for (int t = 0; t < 16; t++) {
+			float weight = WEIGHTS[indices[t]] / 64.0f;
+			aa += (1.0f - weight) * (1.0f - weight);
+			ab += (1.0f - weight) * weight;
+			bb += weight * weight;
+			for (int c = 0; c < 3; c++) {
+				ax[c] += (1.0f - weight) * texels[t][c];
+				bx[c] += weight * texels[t][c];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f) return false;
+		for (int c = 0; c < 3; c++) {
+			float endpointA = (ax[c] * bb - bx[c] * ab) / determinant;
+			float endpointB = (bx[c] * aa - ax[c] * ab) / determinant;
+			a[c] = Quantize(std::min(std::max(endpointA, 0.0f), (float)MAX_HALF));
+			b[c] = Quantize(std::min(std::max(endpointB, 0.0f), (float)MAX_HALF));
+		}
+		return true;
+	}
+	inline void WriteBits(uint8_t block[16], int& position, uint32_t value, int count) {
+		for (int i = 0; i < count; i++, position++) {
+			if (value & (1u << i)) block[position >> 3] |= (uint8_t)(1u << (position & 7));
+		}
+	}
+	// texels holds half bit patterns, 16 texels of rgb in rows of four.
+	inline void EncodeBlock(const float texels[16][3], uint8_t block[16]) {
+		// Candidate lines: the principal axis through the mean, and the bounding box diagonal.
+		glm::vec3 mean(0.0f), low(1e30f), high(0.0f);
+		for (int t = 0; t < 16; t++) {
+			glm::vec3 texel(texels[t][0], texels[t][1], texels[t][2]);
+			mean += texel / 16.0f;
+			low = glm::min(low, texel);
+			high = glm::max(high, texel);
+		}
+		glm::mat3 covariance(0.0f);
+		for (int t = 0; t < 16; t++) {
+			glm::vec3 offset = glm::vec3(texels[t][0], texels[t][1], texels[t][2]) - mean;
+			covariance += glm::outerProduct(offset, offset);
+		}
+		glm::vec3 axis = high - low;
+		for (int i = 0; i < 8; i++) {
+			glm::vec3 next = covariance * axis;
+			float length = glm::length(next);
+			if (length < 1e-6f) break;
+			axis = next / length;
+		}
+		float tMin = 1e30f, tMax = -1e30f;
+		for (int t = 0; t < 16; t++) {
+			float along = glm::dot(glm::vec3(texels[t][0], texels[t][1], texels[t][2]) - mean, axis);
+			tMin = std::min(tMin, along);
+			tMax = std::max(tMax, along);
+		}
+		glm::vec3 candidates[2][2] = {
+			{ mean + axis * tMin, mean + axis * tMax },
+			{ low, high }
+		};
+
+		int a[3], b[3], indices[16];
+		float bestError = 1e30f;
+		for (glm::vec3* candidate : candidates) {
+			int candidateA[3], candidateB[3], candidateIndices[16];
+			for (int c = 0; c < 3; c++) {
+				candidateA[c] = Quantize(glm::clamp(candidate[0][c], 0.0f, (float)MAX_HALF));
+				candidateB[c] = Quantize(glm::clamp(candidate[1][c], 0.0f, (float)MAX_HALF));
+			}
+			float error = FitIndices(texels, candidateA, candidateB, candidateIndices);
+			if (error < bestError) {
+				bestError = error;
+				memcpy(a, candidateA, sizeof(a));
+				memcpy(b, candidateB, sizeof(b));
+				memcpy(indices, candidateIndices, sizeof(indices));
+			}
+		}
+		for (int iteration = 0; iteration < 2; iteration++) {
+			int refinedA[3], refinedB[3], refinedIndices[16];
+			if (!RefitEndpoints(texels, indices, refinedA, refinedB)) break;
+			float error = FitIndices(texels, refinedA, refinedB, refinedIndices);
+			if (error >= bestError) break;
+			bestError = error;
+			memcpy(a, refinedA, sizeof(a));
+			memcpy(b, refinedB, sizeof(b));
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+		// The first index is stored without its top bit, which must therefore be zero. The weights are
+		// symmetric, so swapping the endpoints and mirroring the indices decodes to the same texels.
+		if (indices[0] >= 8) {
+			for (int c = 0; c < 3; c++) std::swap(a[c], b[c]);
+			for (int& index : indices) index = 15 - index;
+		}
+
+		memset(block, 0, BLOCK_BYTES);
+		int position = 0;
+		WriteBits(block, position, 0x03, 5);
+		for (int c = 0; c < 3; c++) WriteBits(block, position, a[c], 10);
+		for (int c = 0; c < 3; c++) WriteBits(block, position, b[c], 10);
+		WriteBits(block, position, indices[0], 3);
+		for (int t = 1; t < 16; t++) WriteBits(block, position, indices[t], 4);
+	}
+	// Encodes block rows [blockRowBegin, blockRowEnd) of an RGB float image into out, which holds the
+	// whole level in GL's block order. Edge blocks repeat the last row and column.
+	inline void Encode(const float* rgb, int width, int height, int blockRowBegin, int blockRowEnd, uint8_t* out) {
+		int blocksPerRow = (width + 3) / 4;
+		for (int blockY = blockRowBegin; blockY < blockRowEnd; blockY++) {
+			for (int blockX = 0; blockX < blocksPerRow; blockX++) {
+				float texels[16][3];
+				for (int t = 0; t < 16; t++) {
+					int x = std::min(blockX * 4 + t % 4, width - 1);
+					int y = std::min(blockY * 4 + t / 4, height - 1);
+					const float* pixel = rgb + ((size_t)y * width + x) * 3;
+					for (int c = 0; c < 3; c++) {
+						// Written so NaNs become 0.
+						float value = std::min(std::max(0.0f, pixel[c]), 65504.0f);
+						texels[t][c] = (float)glm::packHalf1x16(value);
+					}
+				}
+				EncodeBlock(texels, out + ((size_t)blockY * blocksPerRow + blockX) * BLOCK_BYTES);
+			}
+		}
+	}
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "Renderer.h"
+#include "SceneDescription.h"
+#include "WindowInfo.h"
+
+// A fixed view of the default volume that stresses one part of the march.
+struct BenchmarkScenario {
+	std::string name;
+	SceneDescription scene;
+};
+struct BenchmarkResult {
+	std::string name;
+	unsigned int width = 0, height = 0;
+	float stepCount = 0.0f;
+	// Per measured frame, sorted.
+	std::vector<double> gpuSeconds;
+	std::vector<double> wallSeconds;
+	// True when the GPU timer reported the frames; software rasterizers may report next to nothing.
+	bool gpuTimed = false;
+};
+
+// End-to-end GPU benchmark: every scenario renders a fixed number of frames after a short warm up,
+// one sample per frame and waiting for each frame, so the numbers are per frame latency with no
+// vsync or presentation in the way. Frames are timed with GL timestamp queries around the graph
+// and with the wall clock, and the results go to a JSON report.
+class Benchmark {
+public:
+	// Canned views of the volume in base. Every resolution is multiplied by scale, for slow hosts.
+	static std::vector<BenchmarkScenario> GetScenarios(const SceneDescription& base, float scale) {
+		std::vector<BenchmarkScenario> scenarios;
+		auto add = [&](const std::string& name, unsigned int width, unsigned int height, glm::vec3 position, glm::vec2 rotation, float stepCount) {
+			SceneDescription scene = base;
+			scene.width = std::max(1u, (unsigned int)(width * scale));
+			scene.height = std::max(1u, (unsigned int)(height * scale));
+			scene.cameraPosition = position;
+			scene.cameraRotation = rotation;
+			scene.volumeStepCount = stepCount;
+			scenarios.push_back(BenchmarkScenario{ name, scene });
+		};
+		glm::vec3 center = (base.volumeMin + base.volumeMax) / 2.0f;
+		glm::vec3 extent = base.volumeMax - base.volumeMin;
+		glm::vec3 front = center + glm::vec3(0.0f, 0.0f, extent.z * 1.75f);
+		// Just above the top face, tilted so the rays skim it.
+		glm::vec3 grazing = glm::vec3(center.x, base.volumeMax.y + extent.y * 0.01f, base.volumeMax.z + extent.z * 0.5f);
+
+		// Looking away from the volume: setup, resolve and the empty ray cost.
+		add("empty-sky", 1280, 720, front, glm::vec2(180.0f, 0.0f), base.volumeStepCount);
+		// Inside the volume: every pixel marches. The light march is nested in the view march, so cost grows with the square of the step count.
+		add("full-fill", 1280, 720, center, glm::vec2(0.0f), base.volumeStepCount);
+		add("grazing", 1280, 720, grazing, glm::vec2(0.0f, -2.0f), base.volumeStepCount);
+		add("high-steps", 1280, 720, center, glm::vec2(0.0f), base.volumeStepCount * 4.0f);
+		add("view-640x360", 640, 360, front, glm::vec2(0.0f), base.volumeStepCount);
+		add("view-1280x720", 1280, 720, front, glm::vec2(0.0f), base.volumeStepCount);
+		add("view-1920x1080", 1920, 1080, front, glm::vec2(0.0f), base.volumeStepCount);
+		return scenarios;
+	}
+	// Needs a current GL context.
+	static BenchmarkResult Run(const BenchmarkScenario& scenario, RenderMode renderMode, unsigned int frameCount, unsigned int warmupCount) {
+		SceneDescription scene = scenario.scene;
+		Renderer renderer(scene.width, scene.height, renderMode, scene.environmentMapPath);
+		renderer.SetPresenting(false);
+
+		Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+		Volume volume = scene.CreateVolume();
+		renderer.SetVolume(volume);
+		renderer.SetCamera(camera);
+
+		std::vector<GLuint> queries((size_t)frameCount * 2);
+		glGenQueries((GLsizei)queries.size(), queries.data());
+
+		BenchmarkResult result;
+		result.name = scenario.name;
+		result.width = scene.width;
+		result.height = scene.height;
+		result.stepCount = volume.stepCount;
+
+		for (unsigned int frame = 0; frame < warmupCount + frameCount; frame++) {
+			bool measured = frame >= warmupCount;
+			size_t query = (size_t)(frame - warmupCount) * 2;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (measured) glQueryCounter(queries[query], GL_TIMESTAMP);
+			renderer.Render(scene.time);
+			if (measured) glQueryCounter(queries[query + 1], GL_TIMESTAMP);
+			glFinish();
+			if (measured) result.wallSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		// Everything has finished, so none of these waits.
+		double gpuTotal = 0.0;
+		for (unsigned int frame = 0; frame < frameCount; frame++) {
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(queries[frame * 2], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(queries[frame * 2 + 1], GL_QUERY_RESULT, &end);
+			result.gpuSeconds.push_back(end > begin ? (end - begin) * 1.0e-9 : 0.0);
+			gpuTotal += result.gpuSeconds.back();
+		}
+		glDeleteQueries((GLsizei)queries.size(), queries.data());
+
+		double wallTotal = 0.0;
+		for (double seconds : result.wallSeconds) wallTotal += seconds;
+		// A timer that accounts for less than a tenth of the wall time is not measuring the work.
+		result.gpuTimed = gpuTotal > wallTotal * 0.1;
+
+		std::sort(result.gpuSeconds.begin(), result.gpuSeconds.end());
+		std::sort(result.wallSeconds.begin(), result.wallSeconds.end());
+		return result;
+	}
+	// Nearest rank on sorted values.
+	static double Percentile(const std::vector<double>& sorted, double percent) {
+		if (sorted.empty()) return 0.0;
+		size_t rank = (size_t)std::ceil(percent / 100.0 * sorted.size());
+		return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+	}
+	static double Mean(const std::vector<double>& values) {
+		double sum = 0.0;
+		for (double value : values) sum += value;
+		return values.empty() ? 0.0 : sum / values.size();
+	}
+	// Samples per second over the frames, from the GPU timer when it measured them and the wall clock otherwise.
+	static double GetSamplesPerSecond(const BenchmarkResult& result) {
+		double mean = Mean(result.gpuTimed ? result.gpuSeconds : result.wallSeconds);
+		return mean > 0.0 ? 1.0 / mean : 0.0;
+	}
+	static bool WriteJson(const std::string& path, const std::vector<BenchmarkResult>& results, RenderMode renderMode, unsigned int frameCount, unsigned int warmupCount) {
+		std::ofstream file = std::ofstream(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write benchmark report <" << path << ">" << std::endl;
+			return false;
+		}
+		file.precision(6);
+		file << "{\n"
+			<< "  \"renderer\": \"" << Escape((const char*)glGetString(GL_RENDERER)) << "\",\n"
+			<< "  \"version\": \"" << Escape((const char*)glGetString(GL_VERSION)) << "\",\n"
+			<< "  \"mode\": \"" << (renderMode == RenderMode::interactive ? "interactive" : "offline") << "\",\n"
+			<< "  \"frames\": " << frameCount << ",\n"
+			<< "  \"warmup_frames\": " << warmupCount << ",\n"
+			<< "  \"samples_per_frame\": 1,\n"
+			<< "  \"scenarios\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const BenchmarkResult& result = results[i];
+			double samplesPerSecond = GetSamplesPerSecond(result);
+			file << "    {\n"
+				<< "      \"name\": \"" << Escape(result.name) << "\",\n"
+				<< "      \"width\": " << result.width << ",\n"
+				<< "      \"height\": " << result.height << ",\n"
+				<< "      \"steps\": " << result.stepCount << ",\n"
+				<< "      \"timer\": \"" << (result.gpuTimed ? "gpu" : "wall") << "\",\n"
+				<< "      \"gpu_ms\": ";
+			WriteStatistics(file, result.gpuSeconds);
+			file << ",\n      \"wall_ms\": ";
+			WriteStatistics(file, result.wallSeconds);
+			file << ",\n"
+				<< "      \"samples_per_second\": " << samplesPerSecond << ",\n"
+				<< "      \"rays_per_second\": " << samplesPerSecond * result.width * result.height << "\n"
+				<< "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+		return !file.fail();
+	}
+	// Text as the contents of a JSON string.
+	static std::string Escape(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') escaped += '\\';
+			if ((unsigned char)c >= 0x20) escaped += c;
+		}
+		return escaped;
+	}
+private:
+	static void WriteStatistics(std::ofstream& file, const std::vector<double>& sorted) {
+		file << "{ \"mean\": " << Mean(sorted) * 1000.0
+			<< ", \"min\": " << (sorted.empty() ? 0.0 : sorted.front() * 1000.0)
+			<< ", \"p50\": " << Percentile(sorted, 50.0) * 1000.0
+			<< ", \"p90\": " << Percentile(sorted, 90.0) * 1000.0
+			<< ", \"p95\": " << Percentile(sorted, 95.0) * 1000.0
+			<< ", \"p99\": " << Percentile(sorted, 99.0) * 1000.0
+			<< ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back() * 1000.0) << " }";
+	}
+};
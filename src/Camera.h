@@ -27,6 +27,9 @@ public:
 	float GetFocalLength() {
 		return focalLength;
 	}
+	float GetYFOV() {
+		return yFOVInDegrees;
+	}
 	void SetMoveSpeed(float moveSpeed) {
 		this->moveSpeed = moveSpeed;
 	}
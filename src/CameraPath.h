@@ -0,0 +1,158 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Camera.h"
+
+// Camera transforms over time, recorded from live input and replayed on a fixed timestep, so that
+// benchmark and regression runs render identical views. Between keys, position and rotation follow
+// a Catmull-Rom spline through the key times, so replaying at a different frame rate than the one
+// recorded still moves smoothly.
+//
+//	"CLRPATH1", uint32 key count, then per key float time, position xyz, rotation quaternion xyzw.
+class CameraPath {
+public:
+	struct Key {
+		float time;
+		glm::vec3 position;
+		glm::quat rotation;
+	};
+public:
+	// Keys must come in increasing time; a key at or before the last one is ignored.
+	void AddKey(float time, Camera& camera) {
+		if (!keys.empty() && time <= keys.back().time) return;
+
+		glm::quat rotation = camera.GetRotation();
+		// q and -q are the same rotation; keep neighbours on the same side so the spline takes the short way.
+		if (!keys.empty() && glm::dot(keys.back().rotation, rotation) < 0.0f) rotation = -rotation;
+		keys.push_back(Key{ time, camera.GetPosition(), rotation });
+	}
+	// Poses the camera at time seconds into the path, holding the first and last key outside of it.
+	void Apply(float time, Camera& camera) {
+		if (keys.empty()) return;
+
+		if (keys.size() == 1 || time <= keys.front().time) return SetPose(camera, keys.front().position, keys.front().rotation);
+		if (time >= keys.back().time) return SetPose(camera, keys.back().position, keys.back().rotation);
+
+		// Segment [i, i + 1] holding time.
+		size_t i = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& key) { return t < key.time; }) - keys.begin() - 1;
+
+		const Key& k0 = keys[i];
+		const Key& k1 = keys[i + 1];
+		float h = k1.time - k0.time;
+		float u = (time - k0.time) / h;
+
+		// Cubic Hermite basis, tangents scaled from per second to the segment.
+		float u2 = u * u, u3 = u2 * u;
+		float h00 = 2.0f * u3 - 3.0f * u2 + 1.0f, h10 = u3 - 2.0f * u2 + u;
+		float h01 = -2.0f * u3 + 3.0f * u2, h11 = u3 - u2;
+
+		glm::vec3 position = h00 * k0.position + h10 * h * PositionTangent(i) + h01 * k1.position + h11 * h * PositionTangent(i + 1);
+		glm::vec4 rotation = h00 * AsVec4(k0.rotation) + h10 * h * RotationTangent(i) + h01 * AsVec4(k1.rotation) + h11 * h * RotationTangent(i + 1);
+		rotation = glm::normalize(rotation);
+		SetPose(camera, position, glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+	}
+	bool Write(const std::string& path) const {
+		std::ofstream file = std::ofstream(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write camera path <" << path << ">" << std::endl;
+			return false;
+		}
+		uint32_t keyCount = (uint32_t)keys.size();
+		file.write(Magic(), 8);
+		file.write((const char*)&keyCount, 4);
+		for (const Key& key : keys) {
+			const float values[8] = { key.time, key.position.x, key.position.y, key.position.z,
+				key.rotation.x, key.rotation.y, key.rotation.z, key.rotation.w };
+			file.write((const char*)values, sizeof(values));
+		}
+		file.close();
+		if (file.fail()) {
+			std::cout << "ERROR: Could not write camera path <" << path << ">" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	bool Read(const std::string& path) {
+		std::ifstream file = std::ifstream(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not open camera path <" << path << ">" << std::endl;
+			return false;
+		}
+		char magic[8];
+		uint32_t keyCount = 0;
+		file.read(magic, 8);
+		file.read((char*)&keyCount, 4);
+		if (!file || memcmp(magic, Magic(), 8) != 0) {
+			std::cout << "ERROR: <" << path << "> is not a camera path" << std::endl;
+			return false;
+		}
+		keys.resize(keyCount);
+		for (size_t i = 0; i < keys.size(); i++) {
+			float values[8];
+			file.read((char*)values, sizeof(values));
+			keys[i].time = values[0];
+			keys[i].position = glm::vec3(values[1], values[2], values[3]);
+			keys[i].rotation = glm::quat(values[7], values[4], values[5], values[6]);
+			if (i > 0 && glm::dot(keys[i - 1].rotation, keys[i].rotation) < 0.0f) keys[i].rotation = -keys[i].rotation;
+		}
+		if (!file || keys.empty()) {
+			std::cout << "ERROR: Camera path <" << path << "> is truncated" << std::endl;
+			return false;
+		}
+		// Apply() divides by the spacing of neighbouring keys, so times must increase like AddKey() keeps them.
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (!std::isfinite(keys[i].time) || (i > 0 && !(keys[i].time > keys[i - 1].time))) {
+				std::cout << "ERROR: Camera path <" << path << "> has key times that do not increase" << std::endl;
+				keys.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+	// Seconds from the first key to the last.
+	float GetDuration() {
+		return keys.empty() ? 0.0f : keys.back().time - keys.front().time;
+	}
+	// Frames in a replay at framesPerSecond, including both ends.
+	unsigned int GetFrameCount(float framesPerSecond) {
+		return (unsigned int)std::floor(GetDuration() * framesPerSecond) + 1;
+	}
+	// Path time of a frame in such a replay.
+	float GetFrameTime(unsigned int frame, float framesPerSecond) {
+		return keys.empty() ? 0.0f : keys.front().time + frame / framesPerSecond;
+	}
+	size_t GetKeyCount() {
+		return keys.size();
+	}
+private:
+	std::vector<Key> keys;
+private:
+	static const char* Magic() {
+		return "CLRPATH1";
+	}
+	static glm::vec4 AsVec4(glm::quat q) {
+		return glm::vec4(q.x, q.y, q.z, q.w);
+	}
+	static void SetPose(Camera& camera, glm::vec3 position, glm::quat rotation) {
+		camera.SetPosition(position);
+		camera.SetRotation(rotation);
+	}
+	// Per second; central differences over uneven key spacing, one sided at the ends.
+	glm::vec3 PositionTangent(size_t i) {
+		size_t previous = i > 0 ? i - 1 : i, next = i + 1 < keys.size() ? i + 1 : i;
+		return (keys[next].position - keys[previous].position) / (keys[next].time - keys[previous].time);
+	}
+	glm::vec4 RotationTangent(size_t i) {
+		size_t previous = i > 0 ? i - 1 : i, next = i + 1 < keys.size() ? i + 1 : i;
+		return (AsVec4(keys[next].rotation) - AsVec4(keys[previous].rotation)) / (keys[next].time - keys[previous].time);
+	}
+};
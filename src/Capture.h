@@ -0,0 +1,132 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+#include "Renderer.h"
+#include "ImageWriter.h"
+#include "WorkerPool.h"
+
+// Writes every Nth frame of a Renderer to numbered image files without holding up the render loop.
+// Frames are copied through the renderer's ReadbackRing, so a copy completes a few frames after it
+// was queued, and the mapped pixels are encoded in blocks of scanlines on a WorkerPool. The readback
+// slot goes back to the ring once the last block is encoded; a frame that finds every slot busy is
+// skipped instead of waited for, which bounds both memory and the cost to the render thread.
+class FrameCapture {
+public:
+	// Scanlines per encoding job: enough blocks to keep every worker busy on a single 1080p frame.
+	static const unsigned int BLOCK_ROWS = 64;
+public:
+	// Frame n is written to <pathPrefix>_<n>.<extension>. A thread count of zero leaves one core to the renderer.
+	FrameCapture(Renderer& renderer, const std::string& pathPrefix, ImageFormat format, unsigned int interval, unsigned int threadCount = 0) :
+		renderer(renderer),
+		pool(threadCount)
+	{
+		this->pathPrefix = pathPrefix;
+		this->format = format;
+		this->interval = std::max(interval, 1u);
+	}
+	~FrameCapture() {
+		Finish();
+	}
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Call once per rendered frame.
+	void Update() {
+		unsigned int frame = frameIndex++;
+		if (frame % interval != 0) return;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool queued = renderer.ReadLinearOutputAsync([this, frame](unsigned int slot, const void* data, size_t) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Encode(frame, slot, (const float*)data);
+			renderThreadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+		if (queued) capturedCount++;
+		else skippedCount++;
+		renderThreadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	// Waits until every queued frame is on disk. Render thread only.
+	void Finish() {
+		renderer.FinishReadbacks();
+		pool.Wait();
+	}
+	unsigned int GetCapturedCount() {
+		return capturedCount;
+	}
+	// Frames due for capture while every readback slot was still busy.
+	unsigned int GetSkippedCount() {
+		return skippedCount;
+	}
+	unsigned int GetWrittenCount() {
+		return writtenCount.load();
+	}
+	// Time the render thread spent queueing copies and handing them to the encoders.
+	double GetRenderThreadSeconds() {
+		return renderThreadSeconds;
+	}
+	unsigned int GetThreadCount() {
+		return pool.GetThreadCount();
+	}
+	std::string GetPathPattern() {
+		return pathPrefix + "_*." + ImageWriter::GetExtension(format);
+	}
+private:
+	// One captured frame on its way through the encoders. The last block to finish writes the file.
+	struct FrameJob {
+		unsigned int frame = 0;
+		unsigned int slot = 0;
+		const float* pixels = nullptr;
+		std::vector<ImageWriter::EncodedBlock> blocks;
+		std::atomic<unsigned int> remainingCount{ 0 };
+	};
+
+	Renderer& renderer;
+	std::string pathPrefix;
+	ImageFormat format;
+	unsigned int interval;
+
+	unsigned int frameIndex = 0;
+	unsigned int capturedCount = 0, skippedCount = 0;
+	std::atomic<unsigned int> writtenCount{ 0 };
+	double renderThreadSeconds = 0.0;
+
+	// Last, so the workers are gone before anything they use.
+	WorkerPool pool;
+private:
+	void Encode(unsigned int frame, unsigned int slot, const float* pixels) {
+		unsigned int blockCount = (renderer.GetHeight() + BLOCK_ROWS - 1) / BLOCK_ROWS;
+
+		std::shared_ptr<FrameJob> job = std::make_shared<FrameJob>();
+		job->frame = frame;
+		job->slot = slot;
+		job->pixels = pixels;
+		job->blocks.resize(blockCount);
+		job->remainingCount.store(blockCount);
+
+		for (unsigned int i = 0; i < blockCount; i++) pool.Submit([this, job, i]() { EncodeBlock(*job, i); });
+	}
+	void EncodeBlock(FrameJob& job, unsigned int block) {
+		unsigned int width = renderer.GetWidth(), height = renderer.GetHeight();
+		unsigned int begin = block * BLOCK_ROWS, end = std::min(begin + BLOCK_ROWS, height);
+		job.blocks[block] = ImageWriter::EncodeBlock(format, ImageView(width, height, job.pixels), begin, end);
+		if (job.remainingCount.fetch_sub(1) != 1) return;
+
+		// Every block holds its own copy now.
+		renderer.GetReadbackRing().Release(job.slot);
+
+		std::vector<char> header = ImageWriter::EncodeHeader(format, width, height);
+		std::vector<char> trailer = ImageWriter::EncodeTrailer(format, job.blocks);
+		if (ImageWriter::WriteEncoded(GetPath(job.frame), header, job.blocks, trailer)) writtenCount++;
+	}
+	std::string GetPath(unsigned int frame) {
+		char number[16];
+		snprintf(number, sizeof(number), "%06u", frame);
+		return pathPrefix + "_" + number + "." + ImageWriter::GetExtension(format);
+	}
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "Renderer.h"
+#include "AccumulationFile.h"
+
+// Periodic checkpoints of a Renderer's accumulation, so long renders survive the process. The copy
+// goes through the renderer's ReadbackRing and the file is written on a separate thread, so taking a
+// checkpoint never waits on the GPU or the disk. The file holds running sums, sample counts and the
+// sample offset, which is the whole RNG state: Resume() continues with exactly the samples that
+// would have come next.
+class CheckpointWriter {
+public:
+	CheckpointWriter(Renderer& renderer, const std::string& path, double intervalSeconds) : renderer(renderer) {
+		this->path = path;
+		this->intervalSeconds = intervalSeconds;
+		lastCheckpoint = std::chrono::steady_clock::now();
+	}
+	~CheckpointWriter() {
+		renderer.FinishReadbacks();
+		Wait();
+	}
+	CheckpointWriter(const CheckpointWriter&) = delete;
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	// Call once per frame. Starts a checkpoint when the interval has passed and the last one is done.
+	void Update() {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - lastCheckpoint).count() < intervalSeconds) return;
+		if (Request()) lastCheckpoint = now;
+	}
+	// False while the previous checkpoint is still being written or no readback slot is free.
+	bool Request() {
+		unsigned int sampleCount = renderer.GetSampleCount();
+		if (busy.load() || sampleCount == 0) return false;
+		busy.store(true);
+
+		AccumulationFile header;
+		header.width = renderer.GetWidth();
+		header.height = renderer.GetHeight();
+		header.sampleOffset = renderer.GetSampleOffset();
+		header.sampleCount = sampleCount;
+
+		bool queued = renderer.ReadAccumulationAsync([this, header](unsigned int slot, const void* data, size_t) {
+			Wait();
+			writeThread = std::thread([this, header, slot, data]() {
+				AccumulationFile accumulation = header;
+				const float* pixels = (const float*)data;
+				accumulation.pixels.assign(pixels, pixels + (size_t)header.width * header.height * 4);
+				renderer.GetReadbackRing().Release(slot);
+				if (accumulation.Write(path)) writtenCount++;
+				busy.store(false);
+			});
+		});
+		if (!queued) busy.store(false);
+		return queued;
+	}
+	void Wait() {
+		if (writeThread.joinable()) writeThread.join();
+	}
+	unsigned int GetWrittenCount() {
+		return writtenCount.load();
+	}
+	static bool Resume(Renderer& renderer, const std::string& path) {
+		AccumulationFile accumulation;
+		if (!accumulation.Read(path)) {
+			std::cout << "ERROR: Could not read checkpoint <" << path << ">" << std::endl;
+			return false;
+		}
+		if (!renderer.RestoreAccumulation(accumulation)) return false;
+
+		std::cout << "Resumed " << accumulation.sampleCount << " samples from <" << path << ">" << std::endl;
+		return true;
+	}
+private:
+	Renderer& renderer;
+	std::string path;
+	double intervalSeconds;
+	std::chrono::steady_clock::time_point lastCheckpoint;
+
+	std::thread writeThread;
+	std::atomic<bool> busy{ false };
+	std::atomic<unsigned int> writtenCount{ 0 };
+};
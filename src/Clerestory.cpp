@@ -1,126 +1,673 @@
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <map>
+#include <thread>
+#include <vector>
+#include <algorithm>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#include "ShaderProgram.h"
-#include "Mesh.h"
-#include "Primitives.h"
 #include "WindowInfo.h"
-#include "Texture.h"
 #include "Camera.h"
 #include "Volume.h"
+#include "Renderer.h"
+#include "CpuRenderer.h"
+#include "Noise.h"
+#include "CommandLine.h"
+#include "SceneDescription.h"
+#include "HeadlessContext.h"
+#include "ImageWriter.h"
+#include "ImageMetrics.h"
+#include "RenderFarm.h"
+#include "Checkpoint.h"
+#include "Capture.h"
+#include "VideoCapture.h"
+#include "CameraPath.h"
+#include "Benchmark.h"
+#include "MicroBenchmark.h"
+#include "Convergence.h"
+#include "GoldenTest.h"
+#include "Profiler.h"
+#include "DebugLog.h"
+#include "AssetLoader.h"
 
-WindowInfo InitGLFW();
+WindowInfo InitGLFW(unsigned int width, unsigned int height, bool resizable);
 void InitGlAD();
-void APIENTRY glDebugOutput(GLenum source,
-    GLenum type,
-    unsigned int id,
-    GLenum severity,
-    GLsizei length,
-    const char* message,
-    const void* userParam);
-
-int main()
+void InitDebugOutput(DebugOutputMode mode);
+int RenderHeadless(CommandLine& commandLine, SceneDescription& scene);
+int RenderCpu(CommandLine& commandLine, SceneDescription& scene);
+int RenderTiled(CommandLine& commandLine, SceneDescription& scene);
+int RenderReplay(CommandLine& commandLine, SceneDescription& scene);
+void RenderReplayFrame(CommandLine& commandLine, Renderer& renderer, float time);
+int RunBenchmark(CommandLine& commandLine, SceneDescription& scene);
+int RunMicroBenchmark(CommandLine& commandLine, SceneDescription& scene);
+int RunConvergence(CommandLine& commandLine, SceneDescription& scene);
+int RunGoldenTest(CommandLine& commandLine, SceneDescription& scene);
+int RunFarm(CommandLine& commandLine, SceneDescription& scene);
+int RunFarmWorker(CommandLine& commandLine, RenderFarm& farm);
+bool WriteOutputs(CommandLine& commandLine, Image& image);
+void PrintThroughput(SceneDescription& scene, unsigned int sampleCount, double seconds);
+void PrintSchedulerStats(TileScheduler& scheduler);
+void PrintHybridSplit(Renderer& renderer);
+void PrintRayStatistics(const RayStatistics& statistics);
+bool WriteHeatmap(CommandLine& commandLine, Renderer& renderer, Image& image);
+std::unique_ptr<CpuRenderer> CreateHybridCpuRenderer(CommandLine& commandLine, unsigned int width, unsigned int height);
+std::unique_ptr<CheckpointWriter> CreateCheckpointWriter(CommandLine& commandLine, Renderer& renderer);
+std::unique_ptr<FrameCapture> CreateFrameCapture(CommandLine& commandLine, Renderer& renderer);
+std::unique_ptr<VideoCapture> CreateVideoCapture(CommandLine& commandLine, Renderer& renderer);
+void PrintVideoStats(CommandLine& commandLine, VideoCapture& video);
+void PrintCaptureStats(FrameCapture& capture, double seconds);
+
+int main(int argc, char* argv[])
 {
-    WindowInfo windowInfo = InitGLFW();
-    InitGlAD();
+    CommandLine commandLine = CommandLine(argc, argv);
+    SceneDescription scene = commandLine.scenePath.empty() ? SceneDescription() : SceneDescription(commandLine.scenePath);
+    if (commandLine.width) scene.width = commandLine.width;
+    if (commandLine.height) scene.height = commandLine.height;
+    Profiler::SetThreadName("Render thread");
+    ProfileCapture profileCapture(commandLine.profilePath);
 
-    glDebugMessageCallback(glDebugOutput, nullptr);
-    glEnable(GL_DEBUG_OUTPUT);
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    if (commandLine.benchmark) return RunBenchmark(commandLine, scene);
+    if (commandLine.microbenchmark) return RunMicroBenchmark(commandLine, scene);
+    if (commandLine.convergence) return RunConvergence(commandLine, scene);
+    if (commandLine.golden) return RunGoldenTest(commandLine, scene);
+    if (commandLine.farmRole != FarmRole::none) return RunFarm(commandLine, scene);
+    if (commandLine.cpu) return RenderCpu(commandLine, scene);
+    if (commandLine.tileSize) return RenderTiled(commandLine, scene);
+    if (commandLine.headless && !commandLine.replayPath.empty()) return RenderReplay(commandLine, scene);
+    if (commandLine.headless) return RenderHeadless(commandLine, scene);
+    // ---------------------------------
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    // Checkpoints, captures and replays are written at one fixed size.
+    bool fixedSize = !commandLine.checkpointPath.empty() || !commandLine.resumePath.empty() || !commandLine.capturePath.empty()
+        || !commandLine.videoPath.empty() || !commandLine.replayPath.empty();
+    WindowInfo windowInfo = InitGLFW(scene.width, scene.height, !fixedSize);
+    InitGlAD();
+    InitDebugOutput(commandLine.debugOutputMode);
 
     glEnable(GL_FRAMEBUFFER_SRGB);
     // ---------------------------------
-    Mesh quad = Mesh(QUAD_VERTS, QUAD_INDICES);
-    // ---------------------------------
-    ShaderProgram postProcessShader = ShaderProgram("src/Shaders/NDC.vert", "src/Shaders/PostProcess.frag");
-    ShaderProgram renderShader = ShaderProgram("src/Shaders/Render.comp");
+    AssetLoader assetLoader;
+    std::unique_ptr<CpuRenderer> cpuRenderer = CreateHybridCpuRenderer(commandLine, windowInfo.width, windowInfo.height);
+    Renderer renderer(windowInfo.width, windowInfo.height, commandLine.renderMode, scene.environmentMapPath, cpuRenderer.get(), &assetLoader);
     // ---------------------------------
-    Texture cumulativeRenderTexture = Texture(windowInfo.width, windowInfo.height);
-    Texture finalRenderTexture = Texture(windowInfo.width, windowInfo.height);
-    Texture environmentMap = Texture("HDRIs/puresky.hdr");
-
-    cumulativeRenderTexture.BindImageTexture(1, GL_READ_WRITE);
-    finalRenderTexture.BindImageTexture(0, GL_WRITE_ONLY);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, finalRenderTexture.GetID());
-
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, environmentMap.GetID());
-
-    postProcessShader.SetInt("finalRenderTexture", 0);
-    renderShader.SetInt("environmentMap", 1);
-    // ---------------------------------
-    Camera camera = Camera(45.0f, windowInfo);
+    Camera camera = scene.CreateCamera(windowInfo);
     camera.SetMoveSpeed(40.0f);
     // ---------------------------------
-    Volume volume = Volume(glm::vec3(-1.0) * 10.0f, glm::vec3(1.0) * 10.0f);
-    renderShader.SetVec3("volume.cornerMin", volume.cornerMin);
-    renderShader.SetVec3("volume.cornerMax", volume.cornerMax);
-    renderShader.SetVec3("volume.center", (volume.cornerMin + volume.cornerMax) / 2.0f);
+    Volume volume = scene.CreateVolume();
+    renderer.SetVolume(volume);
+    renderer.SetCamera(camera);
+    renderer.SetDebugView(commandLine.debugView);
+    renderer.SetCollectingRayStatistics(commandLine.rayStatistics);
+    // Resumed samples, captures and replays must not start out with the placeholder sky.
+    bool needsAssets = !commandLine.resumePath.empty() || !commandLine.capturePath.empty() || !commandLine.videoPath.empty() || !commandLine.replayPath.empty();
+    if (needsAssets) assetLoader.Finish();
+    std::unique_ptr<CheckpointWriter> checkpointWriter = CreateCheckpointWriter(commandLine, renderer);
+    if (!commandLine.resumePath.empty() && !CheckpointWriter::Resume(renderer, commandLine.resumePath)) return -1;
+    std::unique_ptr<FrameCapture> frameCapture = CreateFrameCapture(commandLine, renderer);
+    std::unique_ptr<VideoCapture> videoCapture = CreateVideoCapture(commandLine, renderer);
+    if (!commandLine.videoPath.empty() && !videoCapture) return -1;
+    CameraPath recording, replay;
+    if (!commandLine.replayPath.empty() && !replay.Read(commandLine.replayPath)) return -1;
+    unsigned int replayFrame = 0;
+    bool debugViewKeyDown = false;
+    float lastStatisticsTime = 0.0f;
+    bool firstFrame = true, assetsLoaded = false;
     // ---------------------------------
     float lastTime = 0.0f;
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     // ---------------------------------
 
-    float sampleNum = 1.0;
-    glm::mat4 lastCamerModelMatrix = camera.GetModelMatrix();
-
     while (!glfwWindowShouldClose(windowInfo.window)) {
+        PROFILE_ZONE("Frame");
         // Calculate delta time
         float currTime = glfwGetTime();
         float deltaTime = currTime - lastTime;
         lastTime = currTime;
 
-        // Input
-        if (glfwGetKey(windowInfo.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(windowInfo.window, true);
-        camera.ProcessInput(windowInfo, deltaTime);
+        // Resize
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(windowInfo.window, &framebufferWidth, &framebufferHeight);
+        // A minimized window has a zero sized framebuffer; keep the old targets until it comes back.
+        if (framebufferWidth > 0 && framebufferHeight > 0
+            && ((unsigned int)framebufferWidth != windowInfo.width || (unsigned int)framebufferHeight != windowInfo.height)) {
+            windowInfo.width = framebufferWidth;
+            windowInfo.height = framebufferHeight;
+            glViewport(0, 0, framebufferWidth, framebufferHeight);
+            renderer.Resize(windowInfo.width, windowInfo.height);
+            camera.SetYFOV(camera.GetYFOV(), windowInfo);
+        }
 
-        if (lastCamerModelMatrix != camera.GetModelMatrix()) {
-            sampleNum = 1.0;
-            lastCamerModelMatrix = camera.GetModelMatrix();
+        // Input
+        float replayTime = 0.0f;
+        {
+            PROFILE_ZONE("Input");
+            if (glfwGetKey(windowInfo.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(windowInfo.window, true);
+            bool debugViewKey = glfwGetKey(windowInfo.window, GLFW_KEY_V) == GLFW_PRESS;
+            if (debugViewKey && !debugViewKeyDown) {
+                renderer.SetDebugView(RayStatistics::GetNextDebugView(renderer.GetDebugView()));
+                std::cout << "Debug view: " << RayStatistics::GetDebugViewName(renderer.GetDebugView()) << std::endl;
+            }
+            debugViewKeyDown = debugViewKey;
+            if (replay.GetKeyCount()) {
+                if (replayFrame == replay.GetFrameCount(commandLine.replayFramesPerSecond)) break;
+                replayTime = replay.GetFrameTime(replayFrame++, commandLine.replayFramesPerSecond);
+                replay.Apply(replayTime, camera);
+            }
+            else camera.ProcessInput(windowInfo, deltaTime);
+            if (!commandLine.recordPath.empty()) recording.AddKey(currTime, camera);
         }
 
         // Render
+        assetLoader.Update();
+        if (!assetsLoaded && assetLoader.IsIdle()) {
+            std::cout << "Assets loaded after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() << "ms" << std::endl;
+            assetsLoaded = true;
+        }
         glClear(GL_COLOR_BUFFER_BIT);
-        
-        renderShader.SetFloat("_Time", currTime);
-        renderShader.SetFloat("_SampleNum", sampleNum);
 
-        renderShader.SetVec3("camera.pos", camera.GetPosition());
+        renderer.SetCamera(camera);
+        if (replay.GetKeyCount()) RenderReplayFrame(commandLine, renderer, scene.time + replayTime);
+        else renderer.Render(currTime);
+        {
+            PROFILE_ZONE("Captures");
+            if (checkpointWriter) checkpointWriter->Update();
+            if (frameCapture) frameCapture->Update();
+            if (videoCapture) videoCapture->Update();
+        }
+        if (commandLine.rayStatistics && currTime - lastStatisticsTime >= 1.0f) {
+            PrintRayStatistics(renderer.GetRayStatistics());
+            renderer.ResetRayStatistics();
+            lastStatisticsTime = currTime;
+        }
 
-        renderShader.SetVec3("camera.xAxis", camera.GetXAxis());
-        renderShader.SetVec3("camera.yAxis", camera.GetYAxis());
-        renderShader.SetVec3("camera.zAxis", camera.GetZAxis());
+        // Poll events and swap buffers
+        {
+            PROFILE_ZONE("Poll events");
+            glfwPollEvents();
+        }
+        {
+            PROFILE_ZONE("Swap buffers");
+            glfwSwapBuffers(windowInfo.window);
+        }
+        if (firstFrame) std::cout << "First frame after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() << "ms" << std::endl;
+        firstFrame = false;
+    }
+    if (frameCapture) {
+        frameCapture->Finish();
+        PrintCaptureStats(*frameCapture, glfwGetTime());
+    }
+    if (videoCapture) {
+        videoCapture->Close();
+        PrintVideoStats(commandLine, *videoCapture);
+    }
+    if (!commandLine.recordPath.empty()) {
+        if (!recording.Write(commandLine.recordPath)) return -1;
+        std::cout << "Recorded " << recording.GetKeyCount() << " camera keys (" << recording.GetDuration() << "s) to <"
+            << commandLine.recordPath << ">" << std::endl;
+    }
+
+    return 0;
+}
 
-        renderShader.SetFloat("camera.focalLength", camera.GetFocalLength());
+int RenderHeadless(CommandLine& commandLine, SceneDescription& scene) {
+    HeadlessContext context;
+    InitDebugOutput(commandLine.debugOutputMode);
 
-        renderShader.Use();
-        glDispatchCompute(glm::ceil(windowInfo.width / 8), glm::ceil(windowInfo.height / 4), 1);
-        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    std::unique_ptr<CpuRenderer> cpuRenderer = CreateHybridCpuRenderer(commandLine, scene.width, scene.height);
+    Renderer renderer(scene.width, scene.height, commandLine.renderMode, scene.environmentMapPath, cpuRenderer.get());
+    renderer.SetPresenting(false);
 
-        postProcessShader.Use();
-        quad.Draw();
-        ShaderProgram::Unuse();
+    Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+    Volume volume = scene.CreateVolume();
+    renderer.SetVolume(volume);
+    renderer.SetCamera(camera);
+    renderer.SetDebugView(commandLine.debugView);
+    renderer.SetCollectingRayStatistics(commandLine.rayStatistics);
 
-        sampleNum++;
+    std::unique_ptr<CheckpointWriter> checkpointWriter = CreateCheckpointWriter(commandLine, renderer);
+    if (!commandLine.resumePath.empty() && !CheckpointWriter::Resume(renderer, commandLine.resumePath)) return -1;
+    unsigned int resumedSamples = renderer.GetSampleCount();
+    std::unique_ptr<FrameCapture> frameCapture = CreateFrameCapture(commandLine, renderer);
+    std::unique_ptr<VideoCapture> videoCapture = CreateVideoCapture(commandLine, renderer);
+    if (!commandLine.videoPath.empty() && !videoCapture) return -1;
 
-        // Poll events and swap buffers
-        glfwPollEvents();
-        glfwSwapBuffers(windowInfo.window);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while (renderer.GetSampleCount() < commandLine.sampleCount) {
+        renderer.Render(scene.time);
+        PROFILE_ZONE("Captures");
+        if (checkpointWriter) checkpointWriter->Update();
+        if (frameCapture) frameCapture->Update();
+        if (videoCapture) videoCapture->Update();
+    }
+    Image image = renderer.ReadLinearOutput();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    PrintThroughput(scene, renderer.GetSampleCount() - resumedSamples, seconds);
+    if (renderer.IsHybrid()) PrintHybridSplit(renderer);
+    if (commandLine.rayStatistics) {
+        renderer.FinishReadbacks();
+        PrintRayStatistics(renderer.GetRayStatistics());
+    }
+    if (commandLine.debugView != DebugView::radiance && !WriteHeatmap(commandLine, renderer, image)) return -1;
+    if (frameCapture) {
+        frameCapture->Finish();
+        PrintCaptureStats(*frameCapture, seconds);
+    }
+    if (videoCapture) {
+        videoCapture->Close();
+        PrintVideoStats(commandLine, *videoCapture);
+    }
+    if (checkpointWriter) {
+        checkpointWriter.reset();
+        std::cout << "Wrote checkpoints to <" << commandLine.checkpointPath << ">" << std::endl;
+    }
+
+    return WriteOutputs(commandLine, image) ? 0 : -1;
+}
+// Poster resolutions: only one tile lives on the GPU and in host memory at a time, and each finished
+// tile goes straight to disk.
+int RenderTiled(CommandLine& commandLine, SceneDescription& scene) {
+    HeadlessContext context;
+    InitDebugOutput(commandLine.debugOutputMode);
+
+    unsigned int tileSize = commandLine.tileSize, overlap = commandLine.tileOverlap;
+    unsigned int windowSize = tileSize + overlap * 2;
+    Renderer renderer(windowSize, windowSize, commandLine.renderMode, scene.environmentMapPath);
+    renderer.SetPresenting(false);
+
+    Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+    Volume volume = scene.CreateVolume();
+    renderer.SetVolume(volume);
+    renderer.SetCamera(camera);
+
+    TiledEXRWriter writer;
+    if (!writer.Open(commandLine.outputPath + ".exr", scene.width, scene.height, tileSize)) return -1;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // EXR tiles count from the top, image rows from the bottom.
+    for (unsigned int tileY = 0; tileY < writer.GetTileCountY(); tileY++) {
+        for (unsigned int tileX = 0; tileX < writer.GetTileCountX(); tileX++) {
+            unsigned int tileWidth = writer.GetTileWidth(tileX), tileHeight = writer.GetTileHeight(tileY);
+            int x = (int)(tileX * tileSize), y = (int)(scene.height - tileY * tileSize - tileHeight);
+
+            renderer.SetCropWindow(x - (int)overlap, y - (int)overlap, scene.width, scene.height);
+            for (unsigned int i = 0; i < commandLine.sampleCount; i++) renderer.Render(scene.time);
+            Image window = renderer.ReadLinearOutput();
+
+            Image tile = Image(tileWidth, tileHeight);
+            for (unsigned int row = 0; row < tileHeight; row++) {
+                const float* source = window.Pixel(overlap, overlap + row);
+                std::copy(source, source + tileWidth * 3, tile.Pixel(0, row));
+            }
+            if (!writer.WriteTile(tileX, tileY, tile)) return -1;
+        }
+        std::cout << "Tile row " << tileY + 1 << "/" << writer.GetTileCountY() << " written" << std::endl;
+    }
+    if (!writer.Close()) return -1;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    PrintThroughput(scene, commandLine.sampleCount, seconds);
+    return 0;
+}
+// Benchmark runs: the camera follows a recorded path at a fixed timestep, every frame renders the same
+// number of fresh samples, and the time each frame takes on the GPU is reported.
+int RenderReplay(CommandLine& commandLine, SceneDescription& scene) {
+    CameraPath replay;
+    if (!replay.Read(commandLine.replayPath)) return -1;
+
+    HeadlessContext context;
+    InitDebugOutput(commandLine.debugOutputMode);
+
+    std::unique_ptr<CpuRenderer> cpuRenderer = CreateHybridCpuRenderer(commandLine, scene.width, scene.height);
+    Renderer renderer(scene.width, scene.height, commandLine.renderMode, scene.environmentMapPath, cpuRenderer.get());
+    renderer.SetPresenting(false);
+
+    Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+    Volume volume = scene.CreateVolume();
+    renderer.SetVolume(volume);
+
+    std::unique_ptr<FrameCapture> frameCapture = CreateFrameCapture(commandLine, renderer);
+    std::unique_ptr<VideoCapture> videoCapture = CreateVideoCapture(commandLine, renderer);
+    if (!commandLine.videoPath.empty() && !videoCapture) return -1;
+
+    unsigned int frameCount = replay.GetFrameCount(commandLine.replayFramesPerSecond);
+    std::vector<double> frameSeconds;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
+        float time = replay.GetFrameTime(frame, commandLine.replayFramesPerSecond);
+        replay.Apply(time, camera);
+        renderer.SetCamera(camera);
+        RenderReplayFrame(commandLine, renderer, scene.time + time);
+        // Frame times only mean something once the GPU is done with the frame.
+        glFinish();
+        frameSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count());
+
+        if (frameCapture) frameCapture->Update();
+        if (videoCapture) videoCapture->Update();
+    }
+    Image image = renderer.ReadLinearOutput();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(frameSeconds.begin(), frameSeconds.end());
+    std::cout << "Replayed " << frameCount << " frames of <" << commandLine.replayPath << "> at " << commandLine.replayFramesPerSecond
+        << " fps, " << commandLine.replaySamplesPerFrame << " samples per frame in " << seconds << "s" << std::endl;
+    std::cout << "Frame time: median " << frameSeconds[frameSeconds.size() / 2] * 1000.0 << "ms, 95th percentile "
+        << frameSeconds[frameSeconds.size() * 95 / 100] * 1000.0 << "ms, max " << frameSeconds.back() * 1000.0 << "ms" << std::endl;
+    PrintThroughput(scene, frameCount * commandLine.replaySamplesPerFrame, seconds);
+    if (frameCapture) {
+        frameCapture->Finish();
+        PrintCaptureStats(*frameCapture, seconds);
+    }
+    if (videoCapture) {
+        videoCapture->Close();
+        PrintVideoStats(commandLine, *videoCapture);
+    }
+
+    // The last frame, for regression runs.
+    return WriteOutputs(commandLine, image) ? 0 : -1;
+}
+// Replayed frames always start over, so every frame renders the same work whether the camera moved or not.
+void RenderReplayFrame(CommandLine& commandLine, Renderer& renderer, float time) {
+    renderer.ResetAccumulation();
+    for (unsigned int i = 0; i < commandLine.replaySamplesPerFrame; i++) renderer.Render(time);
+}
+std::unique_ptr<CheckpointWriter> CreateCheckpointWriter(CommandLine& commandLine, Renderer& renderer) {
+    if (commandLine.checkpointPath.empty()) return nullptr;
+    return std::unique_ptr<CheckpointWriter>(new CheckpointWriter(renderer, commandLine.checkpointPath, commandLine.checkpointInterval));
+}
+std::unique_ptr<FrameCapture> CreateFrameCapture(CommandLine& commandLine, Renderer& renderer) {
+    if (commandLine.capturePath.empty()) return nullptr;
+    return std::unique_ptr<FrameCapture>(new FrameCapture(renderer, commandLine.capturePath, commandLine.captureFormat,
+        commandLine.captureInterval, commandLine.captureThreadCount));
+}
+std::unique_ptr<VideoCapture> CreateVideoCapture(CommandLine& commandLine, Renderer& renderer) {
+    if (commandLine.videoPath.empty()) return nullptr;
+
+    std::unique_ptr<VideoCapture> video(new VideoCapture(renderer, commandLine.videoQueueDepth));
+    if (!video->Open(commandLine.videoPath, commandLine.videoFormat, commandLine.videoFramesPerSecond)) return nullptr;
+    return video;
+}
+std::unique_ptr<CpuRenderer> CreateHybridCpuRenderer(CommandLine& commandLine, unsigned int width, unsigned int height) {
+    if (!commandLine.hybrid) return nullptr;
+
+    std::unique_ptr<CpuRenderer> cpuRenderer(new CpuRenderer(width, height, commandLine.isa, commandLine.threadCount));
+    std::cout << "Hybrid rendering with " << CpuFeatures::GetName(cpuRenderer->GetIsa()) << " on "
+        << cpuRenderer->GetScheduler().GetThreadCount() << " CPU threads" << std::endl;
+    return cpuRenderer;
+}
+int RenderCpu(CommandLine& commandLine, SceneDescription& scene) {
+    CpuRenderer renderer(scene.width, scene.height, commandLine.isa, commandLine.threadCount);
+
+    Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+    Volume volume = scene.CreateVolume();
+    renderer.SetVolume(volume);
+    renderer.SetCamera(camera);
+
+    std::cout << "CPU reference renderer: " << CpuFeatures::GetName(renderer.GetIsa()) << ", "
+        << renderer.GetScheduler().GetThreadCount() << " threads" << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < commandLine.sampleCount; i++) renderer.Render();
+    Image image = renderer.ReadLinearOutput();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    PrintThroughput(scene, renderer.GetSampleCount(), seconds);
+    PrintSchedulerStats(renderer.GetScheduler());
+
+    return WriteOutputs(commandLine, image) ? 0 : -1;
+}
+int RunFarm(CommandLine& commandLine, SceneDescription& scene) {
+    RenderFarm farm = RenderFarm(commandLine.farmDirectory);
+
+    if (commandLine.farmRole == FarmRole::create) {
+        if (!farm.CreateJob(scene, commandLine.sampleCount, commandLine.farmChunkSize)) return -1;
+        std::cout << "Created render farm job <" << commandLine.farmDirectory << ">: " << commandLine.sampleCount << " samples in "
+            << farm.GetChunkCount() << " chunks" << std::endl;
+        return 0;
     }
+    if (!farm.LoadJob()) return -1;
+    if (commandLine.farmRole == FarmRole::worker) return RunFarmWorker(commandLine, farm);
 
+    Image image;
+    unsigned int mergedSamples;
+    if (!farm.Merge(image, mergedSamples)) return -1;
+    std::cout << "Merged " << mergedSamples << " of " << farm.GetSampleCount() << " samples" << std::endl;
+    return WriteOutputs(commandLine, image) ? 0 : -1;
+}
+int RunFarmWorker(CommandLine& commandLine, RenderFarm& farm) {
+    SceneDescription scene = farm.LoadScene();
+    Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+    Volume volume = scene.CreateVolume();
+
+    // Either the GPU renderer with its context or the CPU renderer, declared so the context goes last.
+    std::unique_ptr<HeadlessContext> context;
+    std::unique_ptr<Renderer> renderer;
+    std::unique_ptr<CpuRenderer> cpuRenderer;
+    if (commandLine.cpu) {
+        cpuRenderer.reset(new CpuRenderer(scene.width, scene.height, commandLine.isa, commandLine.threadCount));
+        cpuRenderer->SetVolume(volume);
+        cpuRenderer->SetCamera(camera);
+    }
+    else {
+        context.reset(new HeadlessContext());
+        InitDebugOutput(commandLine.debugOutputMode);
+        renderer.reset(new Renderer(scene.width, scene.height, RenderMode::offline, scene.environmentMapPath));
+        renderer->SetPresenting(false);
+        renderer->SetVolume(volume);
+        renderer->SetCamera(camera);
+    }
+
+    unsigned int chunk;
+    while (farm.ClaimChunk(chunk)) {
+        AccumulationFile accumulation;
+        accumulation.width = scene.width;
+        accumulation.height = scene.height;
+        accumulation.sampleOffset = farm.GetChunkOffset(chunk);
+        accumulation.sampleCount = farm.GetChunkSampleCount(chunk);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (cpuRenderer) {
+            cpuRenderer->ResetAccumulation();
+            cpuRenderer->SetSampleOffset(accumulation.sampleOffset);
+            for (unsigned int i = 0; i < accumulation.sampleCount; i++) cpuRenderer->Render();
+            accumulation.pixels = cpuRenderer->GetAccumulation();
+        }
+        else {
+            renderer->ResetAccumulation();
+            renderer->SetSampleOffset(accumulation.sampleOffset);
+            for (unsigned int i = 0; i < accumulation.sampleCount; i++) renderer->Render(scene.time);
+            accumulation.pixels = renderer->ReadAccumulation();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!farm.WriteChunk(chunk, accumulation)) return -1;
+        std::cout << "Chunk " << chunk << ": samples " << accumulation.sampleOffset << "-" << accumulation.sampleOffset + accumulation.sampleCount - 1
+            << " in " << seconds << "s" << std::endl;
+    }
+    std::cout << "No chunks left in <" << commandLine.farmDirectory << ">" << std::endl;
+    return 0;
+}
+int RunBenchmark(CommandLine& commandLine, SceneDescription& scene) {
+    HeadlessContext context;
+    InitDebugOutput(commandLine.debugOutputMode);
+
+    std::vector<BenchmarkResult> results;
+    for (const BenchmarkScenario& scenario : Benchmark::GetScenarios(scene, commandLine.benchmarkScale)) {
+        results.push_back(Benchmark::Run(scenario, commandLine.renderMode, commandLine.benchmarkFrameCount, commandLine.benchmarkWarmupCount));
+
+        BenchmarkResult& result = results.back();
+        const std::vector<double>& seconds = result.gpuTimed ? result.gpuSeconds : result.wallSeconds;
+        std::cout << result.name << " (" << result.width << "x" << result.height << ", " << result.stepCount << " steps): "
+            << Benchmark::Mean(seconds) * 1000.0 << " ms mean, " << Benchmark::Percentile(seconds, 95.0) * 1000.0 << " ms p95 ("
+            << (result.gpuTimed ? "GPU" : "wall") << "), " << Benchmark::GetSamplesPerSecond(result) * result.width * result.height / 1.0e6
+            << " Mrays/s" << std::endl;
+    }
+    if (!Benchmark::WriteJson(commandLine.benchmarkPath, results, commandLine.renderMode, commandLine.benchmarkFrameCount, commandLine.benchmarkWarmupCount)) return -1;
+    std::cout << "Wrote <" << commandLine.benchmarkPath << ">" << std::endl;
     return 0;
 }
 
-WindowInfo InitGLFW() {
+int RunConvergence(CommandLine& commandLine, SceneDescription& scene) {
+    HeadlessContext context;
+    InitDebugOutput(commandLine.debugOutputMode);
+
+    std::vector<ConvergenceResult> results;
+    for (const BenchmarkScenario& scenario : ConvergenceBenchmark::GetScenarios(scene, commandLine.benchmarkScale)) {
+        Image reference;
+        std::string referencePath = ConvergenceBenchmark::GetReferencePath(commandLine.convergenceReferencePrefix, scenario, commandLine.convergenceReferenceSampleCount);
+        if (!ConvergenceBenchmark::GetReference(scenario, referencePath, commandLine.convergenceReferenceSampleCount, reference)) return -1;
+
+        results.push_back(ConvergenceBenchmark::Run(scenario, reference, commandLine.renderMode, commandLine.convergenceSampleCount, commandLine.convergenceSeconds));
+        results.back().referencePath = referencePath;
+
+        if (results.back().points.empty()) continue;
+        const ConvergencePoint& last = results.back().points.back();
+        std::cout << scenario.name << " (" << scenario.scene.width << "x" << scenario.scene.height << "): " << last.sampleCount << " samples in "
+            << last.seconds << "s, RMSE " << last.rmse << ", relMSE " << last.relMSE << ", FLIP " << last.flip << std::endl;
+    }
+    if (!ConvergenceBenchmark::WriteJson(commandLine.convergencePath, results, commandLine.renderMode, commandLine.convergenceReferenceSampleCount)) return -1;
+    std::cout << "Wrote <" << commandLine.convergencePath << ">" << std::endl;
+    return 0;
+}
+
+int RunGoldenTest(CommandLine& commandLine, SceneDescription& scene) {
+    HeadlessContext context;
+    InitDebugOutput(commandLine.debugOutputMode);
+
+    std::cout << "Golden images: " << commandLine.goldenSampleCount << " samples at " << GoldenTest::WIDTH << "x" << GoldenTest::HEIGHT
+        << ", tolerance " << commandLine.goldenAbsoluteTolerance << " + " << commandLine.goldenRelativeTolerance << " * |golden|" << std::endl;
+
+    unsigned int failedCount = 0;
+    for (const BenchmarkScenario& scenario : GoldenTest::GetScenarios(scene)) {
+        Image gpu = GoldenTest::RenderGpu(scenario, commandLine.goldenSampleCount);
+        Image cpu = GoldenTest::RenderCpu(scenario, commandLine.goldenSampleCount, commandLine.isa, commandLine.threadCount);
+
+        std::string goldenPath = GoldenTest::GetGoldenPath(commandLine.goldenPrefix, scenario);
+        if (commandLine.goldenUpdate && !ImageWriter::WritePFM(goldenPath, cpu)) return -1;
+        Image golden;
+        if (!ImageReader::ReadPFM(goldenPath, golden)) {
+            std::cout << "ERROR: No golden image <" << goldenPath << ">; create it with --golden-update" << std::endl;
+            return -1;
+        }
+
+        std::string heatmapPrefix = commandLine.outputPath + "_" + scenario.name + "_";
+        float absolute = commandLine.goldenAbsoluteTolerance, relative = commandLine.goldenRelativeTolerance;
+        for (const GoldenComparison& comparison : {
+            GoldenTest::Compare(scenario.name + ": GPU vs golden", gpu, golden, absolute, relative, heatmapPrefix + "gpu-golden.png"),
+            GoldenTest::Compare(scenario.name + ": CPU vs golden", cpu, golden, absolute, relative, heatmapPrefix + "cpu-golden.png"),
+            GoldenTest::Compare(scenario.name + ": GPU vs CPU", gpu, cpu, absolute, relative, heatmapPrefix + "gpu-cpu.png") }) {
+            std::cout << (comparison.Passed() ? "  PASS " : "  FAIL ") << comparison.name << ": max error " << comparison.maxError
+                << " x tolerance, " << comparison.failedPixelCount << " pixels over";
+            if (!comparison.heatmapPath.empty()) std::cout << " <" << comparison.heatmapPath << ">";
+            std::cout << std::endl;
+            if (!comparison.Passed()) failedCount++;
+        }
+    }
+    if (failedCount) {
+        std::cout << failedCount << " comparisons failed" << std::endl;
+        return -1;
+    }
+    std::cout << "All comparisons passed" << std::endl;
+    return 0;
+}
+
+int RunMicroBenchmark(CommandLine& commandLine, SceneDescription& scene) {
+    unsigned int threadCount = commandLine.microbenchmarkThreadCount;
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::map<std::string, MicroBenchmarkResult> baseline;
+    if (!commandLine.microbenchmarkBaselinePath.empty() && !MicroBenchmark::Load(commandLine.microbenchmarkBaselinePath, baseline)) return -1;
+
+    std::cout << "Micro-benchmarks, median of " << commandLine.microbenchmarkRunCount << " runs on 1";
+    if (threadCount > 1) std::cout << " and " << threadCount;
+    std::cout << " threads" << std::endl;
+    std::vector<MicroBenchmarkCase> cases = MicroBenchmark::GetCases(commandLine.microbenchmarkItemCount, scene.environmentMapPath);
+    MicroBenchmark microBenchmark(commandLine.microbenchmarkRunCount, 0.02);
+    std::vector<MicroBenchmarkResult> results = microBenchmark.Run(cases, commandLine.microbenchmarkFilter, { threadCount });
+
+    if (!commandLine.microbenchmarkSavePath.empty()) {
+        if (!MicroBenchmark::Save(commandLine.microbenchmarkSavePath, results)) return -1;
+        std::cout << "Wrote <" << commandLine.microbenchmarkSavePath << ">" << std::endl;
+    }
+    if (!commandLine.microbenchmarkBaselinePath.empty() && !MicroBenchmark::Compare(results, baseline, commandLine.microbenchmarkTolerance)) return -1;
+    return 0;
+}
+bool WriteOutputs(CommandLine& commandLine, Image& image) {
+    bool written = ImageWriter::WriteEXR(commandLine.outputPath + ".exr", image);
+    written &= ImageWriter::WritePFM(commandLine.outputPath + ".pfm", image);
+    written &= ImageWriter::WritePNG(commandLine.outputPath + ".png", image);
+    return written;
+}
+void PrintThroughput(SceneDescription& scene, unsigned int sampleCount, double seconds) {
+    std::cout << "Rendered " << sampleCount << " samples at " << scene.width << "x" << scene.height << " in " << seconds << "s ("
+        << sampleCount / seconds << " samples/s, "
+        << (double)scene.width * scene.height * sampleCount / seconds / 1.0e6 << " Mrays/s)" << std::endl;
+}
+void PrintHybridSplit(Renderer& renderer) {
+    if (!renderer.IsSharingWithCpu()) {
+        std::cout << "Hybrid split: every row on the GPU, the CPU renderer has no debug views or ray statistics" << std::endl;
+        return;
+    }
+    HybridController& controller = renderer.GetHybridController();
+    std::cout << "Hybrid split: " << controller.GetGpuFraction() * 100.0f << "% of rows on the GPU (last sample GPU "
+        << controller.GetGpuSeconds() * 1000.0 << "ms, CPU " << controller.GetCpuSeconds() * 1000.0 << "ms)" << std::endl;
+}
+// Per sample averages of the totals, with the share of the steps empty space skipping and early
+// termination would save.
+void PrintRayStatistics(const RayStatistics& statistics) {
+    if (!statistics.sampleCount || !statistics.rays) return;
+    double samples = statistics.sampleCount;
+    double steps = (double)std::max<uint64_t>(statistics.steps, 1);
+    std::cout << "Ray statistics over " << statistics.sampleCount << " samples: per sample " << statistics.rays / samples << " rays ("
+        << statistics.volumeRays * 100.0 / statistics.rays << "% through the volume), " << statistics.steps / samples << " steps, "
+        << statistics.shadowSteps / samples << " shadow steps, " << statistics.noiseEvaluations / samples << " noise evaluations; "
+        << statistics.emptySteps * 100.0 / steps << "% of steps empty, " << statistics.terminableSteps * 100.0 / steps
+        << "% past early termination" << std::endl;
+}
+// The debug view as the window shows it; the usual outputs hold the raw counts.
+bool WriteHeatmap(CommandLine& commandLine, Renderer& renderer, Image& image) {
+    std::vector<float> values((size_t)image.width * image.height);
+    for (size_t i = 0; i < values.size(); i++) values[i] = image.pixels[i * 3] / renderer.GetHeatmapScale();
+
+    std::string path = commandLine.outputPath + "_" + RayStatistics::GetDebugViewName(commandLine.debugView) + ".png";
+    return ImageWriter::WritePNG(path, image.width, image.height, ImageMetrics::Heatmap(values, image.width, image.height));
+}
+// seconds is the wall time of the render loop the capture ran in.
+void PrintCaptureStats(FrameCapture& capture, double seconds) {
+    std::cout << "Captured " << capture.GetWrittenCount() << " frames to <" << capture.GetPathPattern() << "> on "
+        << capture.GetThreadCount() << " threads (" << capture.GetSkippedCount() << " skipped while every readback was busy, "
+        << capture.GetRenderThreadSeconds() * 1000.0 << "ms on the render thread, "
+        << capture.GetRenderThreadSeconds() / seconds * 100.0 << "% of the loop)" << std::endl;
+}
+void PrintVideoStats(CommandLine& commandLine, VideoCapture& video) {
+    std::cout << "Streamed " << video.GetWrittenCount() << " frames to <" << commandLine.videoPath << "> ("
+        << video.GetDroppedCount() << " dropped while the consumer was behind)" << std::endl;
+}
+void PrintSchedulerStats(TileScheduler& scheduler) {
+    std::cout << "Last sample took " << scheduler.GetFrameSeconds() * 1000.0 << "ms:" << std::endl;
+    const std::vector<TileScheduler::ThreadStats>& stats = scheduler.GetThreadStats();
+    for (size_t i = 0; i < stats.size(); i++) {
+        std::cout << "  thread " << i << ": " << stats[i].tileCount << " tiles (" << stats[i].stealCount << " stolen), "
+            << stats[i].utilization * 100.0 << "% busy" << std::endl;
+    }
+}
+
+WindowInfo InitGLFW(unsigned int width, unsigned int height, bool resizable) {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
 
-    GLFWwindow* window = glfwCreateWindow(1920, 1080, "Clerestory", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(width, height, "Clerestory", NULL, NULL);
     
     if (!window) {
         std::cout << "ERROR: Failed to create GLFW window" << std::endl;
@@ -130,7 +677,7 @@ WindowInfo InitGLFW() {
     glfwMakeContextCurrent(window);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    return WindowInfo(window, 1920, 1080);
+    return WindowInfo(window, width, height);
 }
 void InitGlAD() {
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -138,49 +685,6 @@ void InitGlAD() {
         exit(-1);
     }
 }
-void APIENTRY glDebugOutput(GLenum source,
-    GLenum type,
-    unsigned int id,
-    GLenum severity,
-    GLsizei length,
-    const char* message,
-    const void* userParam)
-{
-    // ignore non-significant error/warning codes
-    if (id == 131169 || id == 131185 || id == 131218 || id == 131204) return;
-
-    std::cout << "---------------" << std::endl;
-    std::cout << "Debug message (" << id << "): " << message << std::endl;
-
-    switch (source)
-    {
-    case GL_DEBUG_SOURCE_API:             std::cout << "Source: API"; break;
-    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   std::cout << "Source: Window System"; break;
-    case GL_DEBUG_SOURCE_SHADER_COMPILER: std::cout << "Source: Shader Compiler"; break;
-    case GL_DEBUG_SOURCE_THIRD_PARTY:     std::cout << "Source: Third Party"; break;
-    case GL_DEBUG_SOURCE_APPLICATION:     std::cout << "Source: Application"; break;
-    case GL_DEBUG_SOURCE_OTHER:           std::cout << "Source: Other"; break;
-    } std::cout << std::endl;
-
-    switch (type)
-    {
-    case GL_DEBUG_TYPE_ERROR:               std::cout << "Type: Error"; break;
-    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: std::cout << "Type: Deprecated Behaviour"; break;
-    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  std::cout << "Type: Undefined Behaviour"; break;
-    case GL_DEBUG_TYPE_PORTABILITY:         std::cout << "Type: Portability"; break;
-    case GL_DEBUG_TYPE_PERFORMANCE:         std::cout << "Type: Performance"; break;
-    case GL_DEBUG_TYPE_MARKER:              std::cout << "Type: Marker"; break;
-    case GL_DEBUG_TYPE_PUSH_GROUP:          std::cout << "Type: Push Group"; break;
-    case GL_DEBUG_TYPE_POP_GROUP:           std::cout << "Type: Pop Group"; break;
-    case GL_DEBUG_TYPE_OTHER:               std::cout << "Type: Other"; break;
-    } std::cout << std::endl;
-
-    switch (severity)
-    {
-    case GL_DEBUG_SEVERITY_HIGH:         std::cout << "Severity: high"; break;
-    case GL_DEBUG_SEVERITY_MEDIUM:       std::cout << "Severity: medium"; break;
-    case GL_DEBUG_SEVERITY_LOW:          std::cout << "Severity: low"; break;
-    case GL_DEBUG_SEVERITY_NOTIFICATION: std::cout << "Severity: notification"; break;
-    } std::cout << std::endl;
-    std::cout << std::endl;
+void InitDebugOutput(DebugOutputMode mode) {
+    DebugLog::Get().Attach(mode);
 }
\ No newline at end of file
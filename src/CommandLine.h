@@ -0,0 +1,337 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+
+#include "RenderMode.h"
+#include "CpuFeatures.h"
+#include "ImageWriter.h"
+#include "VideoCapture.h"
+#include "RayStatistics.h"
+#include "DebugLog.h"
+
+enum class FarmRole {
+	none,
+	create,
+	worker,
+	merge
+};
+
+struct CommandLine {
+	RenderMode renderMode = RenderMode::interactive;
+	std::string scenePath;
+
+	bool headless = false;
+	unsigned int sampleCount = 256;
+	std::string outputPath = "render";
+	// Zero keeps the resolution from the scene.
+	unsigned int width = 0;
+	unsigned int height = 0;
+
+	bool cpu = false;
+	// GPU and CPU share every sample.
+	bool hybrid = false;
+	Isa isa = CpuFeatures::DetectIsa();
+	// Zero uses every core.
+	unsigned int threadCount = 0;
+
+	// Per pixel cost heatmaps instead of radiance (V cycles through them in the window), and per sample
+	// ray totals, printed every second in the window and at the end of a headless render.
+	DebugView debugView = DebugView::radiance;
+	bool rayStatistics = false;
+
+	// GL debug messages: synchronous in debug builds, asynchronous in release builds, or off.
+	DebugOutputMode debugOutputMode = DebugLog::DEFAULT_MODE;
+
+	// Chrome trace of CPU zones and GPU timer scopes over the whole run.
+	std::string profilePath;
+
+	// Accumulation checkpoints: written every checkpointInterval seconds, resumed from resumePath.
+	std::string checkpointPath;
+	double checkpointInterval = 60.0;
+	std::string resumePath;
+
+	// Tiled headless renders: tile edge in pixels (zero renders in one piece) and the margin rendered
+	// around every tile and cropped away.
+	unsigned int tileSize = 0;
+	unsigned int tileOverlap = 0;
+
+	// Render farm: the job directory and what this process does with it.
+	FarmRole farmRole = FarmRole::none;
+	std::string farmDirectory;
+	unsigned int farmChunkSize = 64;
+
+	// Frame capture: every captureInterval-th frame (or sample, headless) to <capturePath>_<n>.<format>.
+	std::string capturePath;
+	unsigned int captureInterval = 1;
+	ImageFormat captureFormat = ImageFormat::png;
+	// Zero leaves one core to the renderer.
+	unsigned int captureThreadCount = 0;
+
+	// Video capture of every presented frame (every sample, headless) to a file or "|command".
+	std::string videoPath;
+	VideoFormat videoFormat = VideoFormat::y4m;
+	unsigned int videoFramesPerSecond = 60;
+	// Frames that may wait for the consumer before new ones are dropped.
+	unsigned int videoQueueDepth = 4;
+
+	// Camera paths: live movement recorded to recordPath, or replayPath replayed instead of input on a
+	// fixed timestep. Every replayed frame restarts the accumulation and renders replaySamplesPerFrame samples.
+	std::string recordPath;
+	std::string replayPath;
+	float replayFramesPerSecond = 60.0f;
+	unsigned int replaySamplesPerFrame = 1;
+
+	// End-to-end benchmark over the canned scenarios in Benchmark.h, written as JSON to benchmarkPath.
+	bool benchmark = false;
+	std::string benchmarkPath = "benchmark.json";
+	unsigned int benchmarkFrameCount = 64;
+	unsigned int benchmarkWarmupCount = 4;
+	float benchmarkScale = 1.0f;
+
+	// Error against cached references over time for the convergence views in Convergence.h, written as
+	// JSON to convergencePath. References are stored as <convergenceReferencePrefix>_<view>_...pfm.
+	bool convergence = false;
+	std::string convergencePath = "convergence.json";
+	std::string convergenceReferencePrefix = "reference";
+	unsigned int convergenceReferenceSampleCount = 4096;
+	unsigned int convergenceSampleCount = 1024;
+	float convergenceSeconds = 0.0f;
+
+	// Golden image regression test in GoldenTest.h: GPU and CPU renders of the benchmark views against
+	// <goldenPrefix>_<view>.pfm. goldenUpdate rewrites the goldens from the CPU renders first. The
+	// default prefix holds the goldens of the default scene that come with the repository.
+	bool golden = false;
+	std::string goldenPrefix = "tests/golden/golden";
+	bool goldenUpdate = false;
+	unsigned int goldenSampleCount = 16;
+	float goldenAbsoluteTolerance = 1.0e-4f;
+	float goldenRelativeTolerance = 1.0e-3f;
+
+	// CPU kernel micro-benchmarks from MicroBenchmark.h whose name contains microbenchmarkFilter, on one
+	// thread and on microbenchmarkThreadCount threads (0 for every core). Results are saved to and
+	// compared against plain text baselines; a regression beyond microbenchmarkTolerance fails the run.
+	bool microbenchmark = false;
+	std::string microbenchmarkFilter;
+	unsigned int microbenchmarkItemCount = 1 << 20;
+	unsigned int microbenchmarkRunCount = 15;
+	unsigned int microbenchmarkThreadCount = 0;
+	std::string microbenchmarkSavePath;
+	std::string microbenchmarkBaselinePath;
+	float microbenchmarkTolerance = 0.05f;
+
+	CommandLine(int argc, char* argv[]) {
+		for (int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+
+			if (argument == "--offline") renderMode = RenderMode::offline;
+			else if (argument == "--headless") {
+				headless = true;
+				renderMode = RenderMode::offline;
+			}
+			else if (argument == "--scene") scenePath = NextValue(argc, argv, i);
+			else if (argument == "--samples") sampleCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--output") outputPath = NextValue(argc, argv, i);
+			else if (argument == "--width") width = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--height") height = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--cpu") {
+				cpu = true;
+				headless = true;
+				renderMode = RenderMode::offline;
+			}
+			else if (argument == "--hybrid") hybrid = true;
+			else if (argument == "--isa") {
+				std::string name = NextValue(argc, argv, i);
+				if (!CpuFeatures::Parse(name, isa)) {
+					std::cout << "ERROR: Unknown instruction set <" << name << ">" << std::endl;
+					exit(-1);
+				}
+			}
+			else if (argument == "--threads") threadCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--debug-view") {
+				std::string name = NextValue(argc, argv, i);
+				if (!RayStatistics::ParseDebugView(name, debugView)) {
+					std::cout << "ERROR: Unknown debug view <" << name << ">" << std::endl;
+					exit(-1);
+				}
+			}
+			else if (argument == "--ray-stats") rayStatistics = true;
+			else if (argument == "--gl-debug") {
+				std::string name = NextValue(argc, argv, i);
+				if (!DebugLog::ParseMode(name, debugOutputMode)) {
+					std::cout << "ERROR: Unknown GL debug mode <" << name << ">" << std::endl;
+					exit(-1);
+				}
+			}
+			else if (argument == "--profile") profilePath = NextValue(argc, argv, i);
+			else if (argument == "--checkpoint") checkpointPath = NextValue(argc, argv, i);
+			else if (argument == "--checkpoint-interval") checkpointInterval = std::stod(NextValue(argc, argv, i));
+			else if (argument == "--resume") resumePath = NextValue(argc, argv, i);
+			else if (argument == "--tile-size") {
+				tileSize = std::stoul(NextValue(argc, argv, i));
+				headless = true;
+				renderMode = RenderMode::offline;
+			}
+			else if (argument == "--tile-overlap") tileOverlap = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--farm-create") SetFarmRole(FarmRole::create, NextValue(argc, argv, i));
+			else if (argument == "--farm-worker") {
+				SetFarmRole(FarmRole::worker, NextValue(argc, argv, i));
+				headless = true;
+				renderMode = RenderMode::offline;
+			}
+			else if (argument == "--farm-merge") SetFarmRole(FarmRole::merge, NextValue(argc, argv, i));
+			else if (argument == "--farm-chunk") farmChunkSize = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--capture") capturePath = NextValue(argc, argv, i);
+			else if (argument == "--capture-every") captureInterval = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--capture-format") {
+				std::string name = NextValue(argc, argv, i);
+				if (!ImageWriter::ParseFormat(name, captureFormat)) {
+					std::cout << "ERROR: Unknown capture format <" << name << ">" << std::endl;
+					exit(-1);
+				}
+			}
+			else if (argument == "--capture-threads") captureThreadCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--video") videoPath = NextValue(argc, argv, i);
+			else if (argument == "--video-format") {
+				std::string name = NextValue(argc, argv, i);
+				if (name == "y4m") videoFormat = VideoFormat::y4m;
+				else if (name == "rgb") videoFormat = VideoFormat::rgb;
+				else {
+					std::cout << "ERROR: Unknown video format <" << name << ">" << std::endl;
+					exit(-1);
+				}
+			}
+			else if (argument == "--video-fps") videoFramesPerSecond = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--video-queue") videoQueueDepth = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--record") recordPath = NextValue(argc, argv, i);
+			else if (argument == "--replay") replayPath = NextValue(argc, argv, i);
+			else if (argument == "--replay-fps") {
+				replayFramesPerSecond = std::stof(NextValue(argc, argv, i));
+				if (!(replayFramesPerSecond > 0.0f) || !std::isfinite(replayFramesPerSecond)) {
+					std::cout << "ERROR: --replay-fps needs a positive frame rate" << std::endl;
+					exit(-1);
+				}
+			}
+			else if (argument == "--replay-samples") replaySamplesPerFrame = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--benchmark") benchmark = true;
+			else if (argument == "--bench-output") benchmarkPath = NextValue(argc, argv, i);
+			else if (argument == "--bench-frames") benchmarkFrameCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--bench-warmup") benchmarkWarmupCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--bench-scale") benchmarkScale = std::stof(NextValue(argc, argv, i));
+			else if (argument == "--convergence") convergence = true;
+			else if (argument == "--conv-output") convergencePath = NextValue(argc, argv, i);
+			else if (argument == "--conv-reference") convergenceReferencePrefix = NextValue(argc, argv, i);
+			else if (argument == "--conv-reference-samples") convergenceReferenceSampleCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--conv-samples") convergenceSampleCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--conv-seconds") convergenceSeconds = std::stof(NextValue(argc, argv, i));
+			else if (argument == "--golden") {
+				golden = true;
+				if (i + 1 < argc && argv[i + 1][0] != '-') goldenPrefix = argv[++i];
+			}
+			else if (argument == "--golden-update") goldenUpdate = true;
+			else if (argument == "--golden-samples") goldenSampleCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--golden-tolerance") goldenAbsoluteTolerance = std::stof(NextValue(argc, argv, i));
+			else if (argument == "--golden-relative") goldenRelativeTolerance = std::stof(NextValue(argc, argv, i));
+			else if (argument == "--microbench") microbenchmark = true;
+			else if (argument == "--bench-noise") {
+				microbenchmark = true;
+				microbenchmarkFilter = "cnoise";
+			}
+			else if (argument == "--bench-filter") microbenchmarkFilter = NextValue(argc, argv, i);
+			else if (argument == "--bench-items") microbenchmarkItemCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--bench-runs") microbenchmarkRunCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--bench-threads") microbenchmarkThreadCount = std::stoul(NextValue(argc, argv, i));
+			else if (argument == "--bench-save") microbenchmarkSavePath = NextValue(argc, argv, i);
+			else if (argument == "--bench-baseline") microbenchmarkBaselinePath = NextValue(argc, argv, i);
+			else if (argument == "--bench-tolerance") microbenchmarkTolerance = std::stof(NextValue(argc, argv, i)) / 100.0f;
+			else {
+				std::cout << "ERROR: Unknown argument <" << argument << ">" << std::endl;
+				PrintUsage();
+				exit(-1);
+			}
+		}
+	}
+	static void PrintUsage() {
+		std::cout << "Usage: Clerestory [options]\n"
+			<< "  --offline            Full precision environment map in the interactive window\n"
+			<< "  --scene <path>       Scene description file\n"
+			<< "  --headless           Render without a window and write <output>.exr/.pfm/.png\n"
+			<< "  --samples <n>        Samples per pixel for headless renders (default 256)\n"
+			<< "  --output <path>      Output path without extension (default render)\n"
+			<< "  --width <n>          Override the scene resolution\n"
+			<< "  --height <n>\n"
+			<< "  --cpu                Headless render with the CPU reference renderer\n"
+			<< "  --hybrid             Split every sample between the GPU and the CPU renderer\n"
+			<< "                       (GPU only with --debug-view or --ray-stats)\n"
+			<< "  --isa <name>         CPU instruction set: scalar, avx2 or avx512 (default widest supported)\n"
+			<< "  --threads <n>        CPU worker threads (default all cores)\n"
+			<< "  --debug-view <v>     radiance, or a per pixel heatmap of steps, noise, shadow-steps or termination\n"
+			<< "                       (the step early termination would stop at); V cycles through them in the window\n"
+			<< "  --ray-stats          Count rays, steps, empty steps and noise evaluations per sample and print them\n"
+			<< "  --gl-debug <mode>    GL debug messages: sync, async or off (default sync in debug builds, async in release)\n"
+			<< "  --profile <path>     Record CPU zones on every thread and GPU pass timings; write a Chrome trace\n"
+			<< "                       (chrome://tracing or ui.perfetto.dev) to path on exit\n"
+			<< "  --checkpoint <path>  Periodically save the accumulation to path\n"
+			<< "  --checkpoint-interval <s>  Seconds between checkpoints (default 60)\n"
+			<< "  --resume <path>      Continue the accumulation saved in a checkpoint\n"
+			<< "  --tile-size <n>      Headless render in n x n tiles streamed to a tiled <output>.exr\n"
+			<< "  --tile-overlap <n>   Extra margin rendered around every tile and cropped (default 0)\n"
+			<< "  --farm-create <dir>  Create a render farm job for the scene, --samples and --farm-chunk\n"
+			<< "  --farm-chunk <n>     Samples per farm chunk (default 64)\n"
+			<< "  --farm-worker <dir>  Render chunks of the job until none are left (GPU, or CPU with --cpu)\n"
+			<< "  --farm-merge <dir>   Merge the finished chunks into <output>.exr/.pfm/.png\n"
+			<< "  --capture <prefix>   Write frames to <prefix>_<n>.png without stalling the renderer\n"
+			<< "  --capture-every <n>  Capture every nth frame, or every nth sample when headless (default 1)\n"
+			<< "  --capture-format <f> png, exr or pfm (default png)\n"
+			<< "  --capture-threads <n>  Image encoding threads (default all cores but one)\n"
+			<< "  --video <path>       Stream tonemapped frames to path, or to a command given as \"|command\"\n"
+			<< "  --video-format <f>   y4m (4:2:0) or rgb (raw rgb24) (default y4m)\n"
+			<< "  --video-fps <n>      Frame rate written to the y4m header (default 60)\n"
+			<< "  --video-queue <n>    Frames buffered for a slow consumer before frames are dropped (default 4)\n"
+			<< "  --record <path>      Record the camera path of the interactive session to path\n"
+			<< "  --replay <path>      Drive the camera along a recorded path, headless or in the window\n"
+			<< "  --replay-fps <n>     Fixed replay timestep in frames per second (default 60)\n"
+			<< "  --replay-samples <n> Samples rendered from scratch for every replayed frame (default 1)\n"
+			<< "  --benchmark          Time every benchmark scenario headless and write a JSON report\n"
+			<< "  --bench-output <path> Benchmark report path (default benchmark.json)\n"
+			<< "  --bench-frames <n>   Measured frames per scenario (default 64)\n"
+			<< "  --bench-warmup <n>   Frames rendered before measuring (default 4)\n"
+			<< "  --bench-scale <f>    Multiplies every scenario resolution, for slow hosts (default 1)\n"
+			<< "  --convergence        Measure error against a reference over render time for the benchmark views\n"
+			<< "  --conv-output <path> Convergence report path (default convergence.json)\n"
+			<< "  --conv-reference <prefix>  Reference images are cached as <prefix>_<view>_<hash>_<n>spp.pfm (default reference)\n"
+			<< "  --conv-reference-samples <n>  Samples per reference image (default 4096)\n"
+			<< "  --conv-samples <n>   Samples rendered per view (default 1024)\n"
+			<< "  --conv-seconds <s>   Also stop each view after s seconds of rendering (default no limit)\n"
+			<< "  --golden [prefix]    Compare GPU and CPU renders of the benchmark views with <prefix>_<view>.pfm\n"
+			<< "                       (default tests/golden/golden, the goldens of the default scene);\n"
+			<< "                       error heatmaps go to <output>_<view>_<comparison>.png\n"
+			<< "  --golden-update      Rewrite the golden images from the CPU renders before comparing\n"
+			<< "  --golden-samples <n> Samples per golden render (default 16)\n"
+			<< "  --golden-tolerance <f>  Absolute per channel tolerance (default 0.0001)\n"
+			<< "  --golden-relative <f>   Tolerance relative to the golden value, added to the absolute one (default 0.001)\n"
+			<< "  --microbench         Time the CPU kernels per instruction set and thread count\n"
+			<< "  --bench-noise        Same as --microbench --bench-filter cnoise\n"
+			<< "  --bench-filter <s>   Only micro-benchmarks whose name contains s\n"
+			<< "  --bench-items <n>    Points and rays per micro-benchmark batch (default 1048576)\n"
+			<< "  --bench-runs <n>     Timed runs per micro-benchmark; the median is reported (default 15)\n"
+			<< "  --bench-threads <n>  Thread count tested besides one (default all cores)\n"
+			<< "  --bench-save <path>  Save the micro-benchmark results as a baseline\n"
+			<< "  --bench-baseline <path>  Compare against a saved baseline and fail on a regression\n"
+			<< "  --bench-tolerance <%>  Slowdown tolerated before a regression is reported (default 5)" << std::endl;
+	}
+private:
+	void SetFarmRole(FarmRole role, const std::string& directory) {
+		farmRole = role;
+		farmDirectory = directory;
+	}
+	static std::string NextValue(int argc, char* argv[], int& i) {
+		if (i + 1 >= argc) {
+			std::cout << "ERROR: Missing value for argument <" << argv[i] << ">" << std::endl;
+			PrintUsage();
+			exit(-1);
+		}
+		return argv[++i];
+	}
+};
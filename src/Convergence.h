@@ -0,0 +1,203 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "Renderer.h"
+#include "SceneDescription.h"
+#include "WindowInfo.h"
+#include "Benchmark.h"
+#include "ImageReader.h"
+#include "ImageWriter.h"
+#include "ImageMetrics.h"
+
+// Error of the progressive output after sampleCount samples and seconds of rendering.
+struct ConvergencePoint {
+	unsigned int sampleCount = 0;
+	double seconds = 0.0;
+	double rmse = 0.0, relMSE = 0.0, flip = 0.0;
+};
+struct ConvergenceResult {
+	std::string name;
+	unsigned int width = 0, height = 0;
+	float stepCount = 0.0f;
+	std::string referencePath;
+	std::vector<ConvergencePoint> points;
+};
+
+// Quality against time rather than time per frame: every view is rendered progressively and the
+// output compared with a high sample reference at sample counts spaced about 25% apart. A kernel
+// that is faster per sample but noisier, or changes the estimator, then shows up as reaching a given
+// error sooner or later. References are rendered once and cached as PFM, keyed by the scene text, so
+// they survive kernel changes; they use RNG streams the progressive render never reaches, so their
+// noise is independent of it.
+class ConvergenceBenchmark {
+public:
+	// Added to the sample index of every reference sample.
+	static const unsigned int REFERENCE_SAMPLE_OFFSET = 1u << 24;
+	// Equal-quality targets reported per metric and scenario at most.
+	static const size_t MAX_TARGETS = 16;
+public:
+	// The benchmark views with something to converge: empty sky and the extra resolutions are left out.
+	static std::vector<BenchmarkScenario> GetScenarios(const SceneDescription& base, float scale) {
+		std::vector<BenchmarkScenario> scenarios;
+		for (BenchmarkScenario& scenario : Benchmark::GetScenarios(base, scale)) {
+			if (scenario.name == "full-fill" || scenario.name == "grazing" || scenario.name == "view-1280x720") scenarios.push_back(scenario);
+		}
+		return scenarios;
+	}
+	// <prefix>_<name>_<scene hash>_<samples>spp.pfm
+	static std::string GetReferencePath(const std::string& prefix, const BenchmarkScenario& scenario, unsigned int sampleCount) {
+		// FNV-1a of everything that changes the image.
+		uint32_t hash = 2166136261u;
+		for (char c : scenario.scene.ToString()) hash = (hash ^ (unsigned char)c) * 16777619u;
+		char text[16];
+		snprintf(text, sizeof(text), "%08x", hash);
+		return prefix + "_" + scenario.name + "_" + text + "_" + std::to_string(sampleCount) + "spp.pfm";
+	}
+	// Loads the cached reference, or renders it offline and caches it. Needs a current GL context.
+	static bool GetReference(const BenchmarkScenario& scenario, const std::string& path, unsigned int sampleCount, Image& reference) {
+		const SceneDescription& scene = scenario.scene;
+		if (ImageReader::ReadPFM(path, reference) && reference.width == scene.width && reference.height == scene.height) return true;
+
+		std::cout << "Rendering reference <" << path << "> (" << sampleCount << " samples)" << std::endl;
+		Renderer renderer(scene.width, scene.height, RenderMode::offline, scene.environmentMapPath);
+		Setup(renderer, scene);
+		renderer.SetSampleOffset(REFERENCE_SAMPLE_OFFSET);
+		renderer.ResetAccumulation();
+		while (renderer.GetSampleCount() < sampleCount) renderer.Render(scene.time);
+		reference = renderer.ReadLinearOutput();
+		return ImageWriter::WritePFM(path, reference);
+	}
+	// Renders up to maxSampleCount samples, or for maxSeconds when that is not zero. Only rendering
+	// is timed; reading the output back and measuring it are not. Needs a current GL context.
+	static ConvergenceResult Run(const BenchmarkScenario& scenario, const Image& reference, RenderMode renderMode, unsigned int maxSampleCount, double maxSeconds) {
+		const SceneDescription& scene = scenario.scene;
+		Renderer renderer(scene.width, scene.height, renderMode, scene.environmentMapPath);
+		Setup(renderer, scene);
+
+		ConvergenceResult result;
+		result.name = scenario.name;
+		result.width = scene.width;
+		result.height = scene.height;
+		result.stepCount = scene.volumeStepCount;
+
+		double seconds = 0.0;
+		unsigned int nextSampleCount = 1;
+		while (renderer.GetSampleCount() < maxSampleCount && (maxSeconds <= 0.0 || seconds < maxSeconds)) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			while (renderer.GetSampleCount() < nextSampleCount) renderer.Render(scene.time);
+			glFinish();
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			Image image = renderer.ReadLinearOutput();
+			ConvergencePoint point;
+			point.sampleCount = renderer.GetSampleCount();
+			point.seconds = seconds;
+			point.rmse = ImageMetrics::RMSE(image, reference);
+			point.relMSE = ImageMetrics::RelMSE(image, reference);
+			point.flip = ImageMetrics::MeanFLIP(image, reference);
+			result.points.push_back(point);
+
+			nextSampleCount = std::min(std::max(nextSampleCount + 1, (unsigned int)std::ceil(nextSampleCount * 1.25)), maxSampleCount);
+		}
+		return result;
+	}
+	// Seconds until the error first drops to target, interpolated log-log between the measurements
+	// around it; negative if it never does. samples receives the matching sample count.
+	static double TimeToReach(const ConvergenceResult& result, double ConvergencePoint::* metric, double target, double& samples) {
+		const std::vector<ConvergencePoint>& points = result.points;
+		for (size_t i = 0; i < points.size(); i++) {
+			if (points[i].*metric > target) continue;
+			samples = points[i].sampleCount;
+			if (i == 0 || target <= 0.0 || points[i].*metric <= 0.0) return points[i].seconds;
+
+			const ConvergencePoint& a = points[i - 1];
+			const ConvergencePoint& b = points[i];
+			double u = std::log(a.*metric / target) / std::log(a.*metric / (b.*metric));
+			samples = std::exp(std::log((double)a.sampleCount) + u * std::log((double)b.sampleCount / a.sampleCount));
+			return std::exp(std::log(a.seconds) + u * std::log(b.seconds / a.seconds));
+		}
+		samples = -1.0;
+		return -1.0;
+	}
+	static bool WriteJson(const std::string& path, const std::vector<ConvergenceResult>& results, RenderMode renderMode, unsigned int referenceSampleCount) {
+		std::ofstream file = std::ofstream(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write convergence report <" << path << ">" << std::endl;
+			return false;
+		}
+		file.precision(6);
+		file << "{\n"
+			<< "  \"renderer\": \"" << Benchmark::Escape((const char*)glGetString(GL_RENDERER)) << "\",\n"
+			<< "  \"mode\": \"" << (renderMode == RenderMode::interactive ? "interactive" : "offline") << "\",\n"
+			<< "  \"reference_samples\": " << referenceSampleCount << ",\n"
+			<< "  \"scenarios\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const ConvergenceResult& result = results[i];
+			file << "    {\n"
+				<< "      \"name\": \"" << Benchmark::Escape(result.name) << "\",\n"
+				<< "      \"width\": " << result.width << ",\n"
+				<< "      \"height\": " << result.height << ",\n"
+				<< "      \"steps\": " << result.stepCount << ",\n"
+				<< "      \"reference\": \"" << Benchmark::Escape(result.referencePath) << "\",\n"
+				<< "      \"curve\": [\n";
+			for (size_t j = 0; j < result.points.size(); j++) {
+				const ConvergencePoint& point = result.points[j];
+				file << "        { \"samples\": " << point.sampleCount << ", \"seconds\": " << point.seconds << ", \"rmse\": " << point.rmse
+					<< ", \"relmse\": " << point.relMSE << ", \"flip\": " << point.flip << " }" << (j + 1 < result.points.size() ? "," : "") << "\n";
+			}
+			file << "      ],\n"
+				<< "      \"equal_quality\": {\n";
+			WriteEqualQuality(file, result, "relmse", &ConvergencePoint::relMSE);
+			file << ",\n";
+			WriteEqualQuality(file, result, "flip", &ConvergencePoint::flip);
+			file << "\n      }\n"
+				<< "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+		return !file.fail();
+	}
+	// Error levels the equal-quality times are reported for: the powers of two below the first
+	// measurement down to the last one, so every target lies on the measured curve. Being powers of
+	// two rather than fractions of the first error, they are the same across reports of one scenario
+	// wherever the curves overlap, which is what comparing two kernels needs.
+	static std::vector<double> GetTargets(const ConvergenceResult& result, double ConvergencePoint::* metric) {
+		std::vector<double> targets;
+		if (result.points.empty()) return targets;
+		double first = result.points.front().*metric, last = result.points.back().*metric;
+		if (!(first > 0.0) || !(last > 0.0) || !std::isfinite(first)) return targets;
+
+		double target = std::exp2(std::ceil(std::log2(first)) - 1.0);
+		for (; target >= last && targets.size() < MAX_TARGETS; target *= 0.5) targets.push_back(target);
+		return targets;
+	}
+private:
+	static void Setup(Renderer& renderer, const SceneDescription& description) {
+		SceneDescription scene = description;
+		renderer.SetPresenting(false);
+		Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+		Volume volume = scene.CreateVolume();
+		renderer.SetVolume(volume);
+		renderer.SetCamera(camera);
+	}
+	static void WriteEqualQuality(std::ofstream& file, const ConvergenceResult& result, const char* name, double ConvergencePoint::* metric) {
+		std::vector<double> targets = GetTargets(result, metric);
+		file << "        \"" << name << "\": [";
+		for (size_t i = 0; i < targets.size(); i++) {
+			double samples = 0.0;
+			double seconds = TimeToReach(result, metric, targets[i], samples);
+			file << (i ? ", " : "") << "{ \"target\": " << targets[i] << ", \"seconds\": ";
+			if (seconds < 0.0) file << "null, \"samples\": null }";
+			else file << seconds << ", \"samples\": " << samples << " }";
+		}
+		file << "]";
+	}
+};
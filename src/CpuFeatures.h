@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// Instruction sets the CPU kernels are compiled for, from narrowest to widest.
+enum class Isa {
+	scalar,
+	avx2,
+	avx512
+};
+
+class CpuFeatures {
+public:
+	// Widest instruction set both the CPU and the OS (saved register state) support.
+	static Isa DetectIsa() {
+		uint32_t leaf0[4], leaf1[4], leaf7[4] = { 0, 0, 0, 0 };
+		Cpuid(0, 0, leaf0);
+		Cpuid(1, 0, leaf1);
+		if (leaf0[0] >= 7) Cpuid(7, 0, leaf7);
+
+		bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+		if (!osxsave) return Isa::scalar;
+		uint64_t xcr0 = ReadXcr0();
+
+		bool avx2 = (leaf1[2] & (1u << 28)) && (leaf1[2] & (1u << 12)) && (leaf7[1] & (1u << 5)) && (xcr0 & 0x6) == 0x6;
+		bool avx512 = avx2 && (leaf7[1] & (1u << 16)) && (xcr0 & 0xE6) == 0xE6;
+
+		if (avx512) return Isa::avx512;
+		if (avx2) return Isa::avx2;
+		return Isa::scalar;
+	}
+	static bool IsSupported(Isa isa) {
+		return (int)isa <= (int)DetectIsa();
+	}
+	static std::string GetName(Isa isa) {
+		switch (isa) {
+		case Isa::scalar: return "scalar";
+		case Isa::avx2:   return "avx2";
+		case Isa::avx512: return "avx512";
+		}
+		return "unknown";
+	}
+	static bool Parse(const std::string& name, Isa& isa) {
+		for (Isa candidate : { Isa::scalar, Isa::avx2, Isa::avx512 }) {
+			if (GetName(candidate) == name) {
+				isa = candidate;
+				return true;
+			}
+		}
+		return false;
+	}
+private:
+	static void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4]) {
+#if defined(_MSC_VER)
+		__cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+	static uint64_t ReadXcr0() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+#endif
+	}
+};
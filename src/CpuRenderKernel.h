@@ -0,0 +1,215 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "Simd.h"
+#include "Noise.h"
+
+// Everything the march needs for one sample, mirroring the uniforms of Render.comp.
+struct CpuRenderContext {
+	unsigned int width, height;
+
+	glm::vec3 cameraPos;
+	glm::vec3 cameraXAxis, cameraYAxis, cameraZAxis;
+	float cameraFocalLength;
+
+	glm::vec3 volumeMin, volumeMax, volumeCenter;
+	float stepCount;
+
+	float sampleNum;
+	// RNG stream of this sample, _SampleIndex in Render.comp.
+	uint32_t sampleIndex;
+	// RGBA, rows bottom to top: rgb running sum, alpha sample count. Same layout as the GPU target.
+	float* accumulation;
+};
+struct CpuTile {
+	unsigned int x0, y0, x1, y1;
+};
+
+// Per instruction set entry points, each built in its own translation unit with the matching compiler flags.
+void RenderTileScalar(const CpuRenderContext& context, const CpuTile& tile);
+void RenderTileAVX2(const CpuRenderContext& context, const CpuTile& tile);
+void RenderTileAVX512(const CpuRenderContext& context, const CpuTile& tile);
+// The slab test on its own, for count rays from context.cameraPos, so its cost can be measured apart from the march.
+void HitVolumeBatchScalar(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count);
+void HitVolumeBatchAVX2(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count);
+void HitVolumeBatchAVX512(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count);
+
+// Packet port of Render.comp. Rays are processed in SoA packets of F::width pixels along a row;
+// lanes that leave the volume early are masked off until the whole packet is done.
+namespace CpuRenderKernel {
+	const float EPSILON = 0.0001f;
+	const float PI = 3.14159265359f;
+	const float noiseScale = 0.2f;
+	const float sunPosition = 10.0f;
+
+	// Same PCG hash and [0, 1) mapping as Render.comp. Internal linkage so every kernel translation
+	// unit keeps its own copy built for its instruction set.
+	static inline uint32_t Hash(uint32_t value) {
+		uint32_t state = value * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+	static inline float Rand(uint32_t& state) {
+		state = Hash(state);
+		return (float)(state >> 8) / 16777216.0f;
+	}
+
+	template<class F> struct Vec3 {
+		F x, y, z;
+
+		Vec3() {}
+		Vec3(F x, F y, F z) : x(x), y(y), z(z) {}
+		Vec3(const glm::vec3& v) : x(v.x), y(v.y), z(v.z) {}
+	};
+	template<class F> Vec3<F> Scaled(const glm::vec3& v, float s) {
+		return Vec3<F>(F(v.x * s), F(v.y * s), F(v.z * s));
+	}
+	template<class F> Vec3<F> operator+(const Vec3<F>& a, const Vec3<F>& b) { return Vec3<F>(a.x + b.x, a.y + b.y, a.z + b.z); }
+	template<class F> Vec3<F> operator-(const Vec3<F>& a, const Vec3<F>& b) { return Vec3<F>(a.x - b.x, a.y - b.y, a.z - b.z); }
+	template<class F> Vec3<F> operator*(const Vec3<F>& a, F s) { return Vec3<F>(a.x * s, a.y * s, a.z * s); }
+	template<class F> F Dot(const Vec3<F>& a, const Vec3<F>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	template<class F> Vec3<F> Normalize(const Vec3<F>& v) {
+		F length = Sqrt(Dot(v, v));
+		return Vec3<F>(v.x / length, v.y / length, v.z / length);
+	}
+
+	// Slab test, returning the clamped entry and the exit distance like HitVolume().
+	template<class F> void HitVolume(const CpuRenderContext& context, const Vec3<F>& origin, const Vec3<F>& dir, F& tMin, F& tMax) {
+		F tx1 = (F(context.volumeMin.x) - origin.x) / dir.x, tx2 = (F(context.volumeMax.x) - origin.x) / dir.x;
+		F tmin = Min(tx1, tx2), tmax = Max(tx1, tx2);
+		F ty1 = (F(context.volumeMin.y) - origin.y) / dir.y, ty2 = (F(context.volumeMax.y) - origin.y) / dir.y;
+		tmin = Max(tmin, Min(ty1, ty2));
+		tmax = Min(tmax, Max(ty1, ty2));
+		F tz1 = (F(context.volumeMin.z) - origin.z) / dir.z, tz2 = (F(context.volumeMax.z) - origin.z) / dir.z;
+		tmin = Max(tmin, Min(tz1, tz2));
+		tmax = Min(tmax, Max(tz1, tz2));
+
+		tMin = Max(F(0.0f), tmin);
+		tMax = tmax;
+	}
+	// The tail is padded into one last packet like Noise::CNoisePackets().
+	template<class F> void HitVolumePackets(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count) {
+		Vec3<F> origin = Vec3<F>(context.cameraPos);
+		F t0, t1;
+		size_t i = 0;
+		for (; i + F::width <= count; i += F::width) {
+			HitVolume(context, origin, Vec3<F>(F::Load(dirX + i), F::Load(dirY + i), F::Load(dirZ + i)), t0, t1);
+			t0.Store(tMin + i);
+			t1.Store(tMax + i);
+		}
+		if (i == count) return;
+
+		float tail[5][F::width];
+		for (int j = 0; j < F::width; j++) tail[0][j] = tail[1][j] = tail[2][j] = 1.0f;
+		for (size_t j = i; j < count; j++) {
+			tail[0][j - i] = dirX[j];
+			tail[1][j - i] = dirY[j];
+			tail[2][j - i] = dirZ[j];
+		}
+		HitVolume(context, origin, Vec3<F>(F::Load(tail[0]), F::Load(tail[1]), F::Load(tail[2])), t0, t1);
+		t0.Store(tail[3]);
+		t1.Store(tail[4]);
+		for (size_t j = i; j < count; j++) {
+			tMin[j] = tail[3][j - i];
+			tMax[j] = tail[4][j - i];
+		}
+	}
+	template<class F> F Density(const CpuRenderContext& context, const Vec3<F>& point) {
+		Vec3<F> noiseSamplePoint = (point - Vec3<F>(context.volumeCenter)) * F(noiseScale);
+		return Max(F(0.0f), Noise::CNoise(noiseSamplePoint.x, noiseSamplePoint.y, noiseSamplePoint.z));
+	}
+	// Render.comp computes this term per step but does not feed it into the estimate yet.
+	template<class F> F PhaseRayleigh(F cosTheta) {
+		return F(3.0f) * (F(1.0f) + cosTheta * cosTheta) / F(16.0f * PI);
+	}
+	template<class F> F OpticalDepth(const CpuRenderContext& context, const Vec3<F>& origin, const Vec3<F>& dir, typename F::Mask active) {
+		F t, tMax;
+		HitVolume(context, origin, dir, t, tMax);
+		t = t + F(EPSILON);
+		tMax = tMax - F(EPSILON);
+
+		F stepSize = (tMax - t) / F(context.stepCount);
+		F opticalDepth = F(0.0f);
+
+		active = active & (t <= tMax - F(EPSILON)) & (tMax >= F(0.0f));
+		while (Any(active)) {
+			Vec3<F> point = origin + dir * t;
+			opticalDepth = opticalDepth + Select(active, Density(context, point) * stepSize, F(0.0f));
+
+			t = t + stepSize;
+			active = active & (t <= tMax - F(EPSILON));
+		}
+		return opticalDepth;
+	}
+	// pixelX and pixelY include the subpixel jitter.
+	template<class F> F March(const CpuRenderContext& context, F pixelX, F pixelY) {
+		F uvX = pixelX / F((float)context.width);
+		F uvY = pixelY / F((float)context.height);
+
+		Vec3<F> cameraPos = Vec3<F>(context.cameraPos);
+		Vec3<F> worldUV = cameraPos
+			- Vec3<F>(context.cameraZAxis) * F(context.cameraFocalLength)
+			+ Scaled<F>(context.cameraXAxis, context.width / 2.0f) * (uvX * F(2.0f) - F(1.0f))
+			+ Scaled<F>(context.cameraYAxis, context.height / 2.0f) * (uvY * F(2.0f) - F(1.0f));
+
+		Vec3<F> dir = Normalize(worldUV - cameraPos);
+
+		F t, tMax;
+		HitVolume(context, cameraPos, dir, t, tMax);
+		t = t + F(EPSILON);
+		tMax = tMax - F(EPSILON);
+		F stepSize = (tMax - t) / F(context.stepCount);
+
+		F transmittance = F(0.0f);
+		F outScatterOpticalDepth = F(0.0f);
+
+		typename F::Mask active = (t <= tMax - F(EPSILON)) & (tMax >= F(0.0f));
+		while (Any(active)) {
+			Vec3<F> point = cameraPos + dir * t;
+			Vec3<F> pointToSun = Normalize(Vec3<F>(F(sunPosition), F(sunPosition), F(sunPosition)) - point);
+
+			F density = Density(context, point);
+			F inScatterOpticalDepth = OpticalDepth(context, point, pointToSun, active);
+
+			outScatterOpticalDepth = outScatterOpticalDepth + Select(active, density, F(0.0f));
+			F scaledOutScatterOpticalDepth = outScatterOpticalDepth * stepSize;
+
+			F contribution = density * Exp(-(inScatterOpticalDepth + scaledOutScatterOpticalDepth)) * stepSize;
+			transmittance = transmittance + Select(active, contribution, F(0.0f));
+
+			t = t + stepSize;
+			active = active & (t <= tMax - F(EPSILON));
+		}
+		return transmittance;
+	}
+	template<class F> void RenderTile(const CpuRenderContext& context, const CpuTile& tile) {
+		float transmittance[F::width];
+		float jitterX[F::width], jitterY[F::width];
+		uint32_t sampleHash = Hash(context.sampleIndex);
+
+		for (unsigned int y = tile.y0; y < tile.y1; y++) {
+			for (unsigned int x = tile.x0; x < tile.x1; x += F::width) {
+				for (int i = 0; i < F::width; i++) {
+					uint32_t state = Hash(y * context.width + x + i + sampleHash);
+					jitterX[i] = Rand(state);
+					jitterY[i] = Rand(state);
+				}
+				F pixelX = F((float)x) + F::Ramp() + F::Load(jitterX);
+				F pixelY = F((float)y) + F::Load(jitterY);
+				March(context, pixelX, pixelY).Store(transmittance);
+
+				unsigned int count = tile.x1 - x < (unsigned int)F::width ? tile.x1 - x : (unsigned int)F::width;
+				for (unsigned int i = 0; i < count; i++) {
+					float* pixel = context.accumulation + ((size_t)y * context.width + x + i) * 4;
+					for (int c = 0; c < 3; c++) {
+						float cumulated = context.sampleNum == 1.0f ? 0.0f : pixel[c];
+						pixel[c] = cumulated + transmittance[i];
+					}
+					pixel[3] = context.sampleNum;
+				}
+			}
+		}
+	}
+}
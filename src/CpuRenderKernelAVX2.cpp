@@ -0,0 +1,12 @@
+#include "CpuRenderKernel.h"
+
+#if !defined(__AVX2__)
+#error "CpuRenderKernelAVX2.cpp must be compiled with AVX2 code generation enabled"
+#endif
+
+void RenderTileAVX2(const CpuRenderContext& context, const CpuTile& tile) {
+	CpuRenderKernel::RenderTile<Float8>(context, tile);
+}
+void HitVolumeBatchAVX2(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count) {
+	CpuRenderKernel::HitVolumePackets<Float8>(context, dirX, dirY, dirZ, tMin, tMax, count);
+}
@@ -0,0 +1,12 @@
+#include "CpuRenderKernel.h"
+
+#if !defined(__AVX512F__)
+#error "CpuRenderKernelAVX512.cpp must be compiled with AVX512 code generation enabled"
+#endif
+
+void RenderTileAVX512(const CpuRenderContext& context, const CpuTile& tile) {
+	CpuRenderKernel::RenderTile<Float16>(context, tile);
+}
+void HitVolumeBatchAVX512(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count) {
+	CpuRenderKernel::HitVolumePackets<Float16>(context, dirX, dirY, dirZ, tMin, tMax, count);
+}
@@ -0,0 +1,8 @@
+#include "CpuRenderKernel.h"
+
+void RenderTileScalar(const CpuRenderContext& context, const CpuTile& tile) {
+	CpuRenderKernel::RenderTile<Float1>(context, tile);
+}
+void HitVolumeBatchScalar(const CpuRenderContext& context, const float* dirX, const float* dirY, const float* dirZ, float* tMin, float* tMax, size_t count) {
+	CpuRenderKernel::HitVolumePackets<Float1>(context, dirX, dirY, dirZ, tMin, tMax, count);
+}
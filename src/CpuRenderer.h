@@ -0,0 +1,141 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "Volume.h"
+#include "Image.h"
+#include "CpuFeatures.h"
+#include "CpuRenderKernel.h"
+#include "TileScheduler.h"
+
+// Reference implementation of Render.comp on the CPU. Tiles are balanced over the cores by a
+// work-stealing TileScheduler and each tile is marched in SIMD packets for the selected instruction set.
+class CpuRenderer {
+public:
+	static const unsigned int TILE_SIZE = 32;
+public:
+	// A thread count of zero uses every hardware thread.
+	CpuRenderer(unsigned int width, unsigned int height, Isa isa = CpuFeatures::DetectIsa(), unsigned int threadCount = 0) {
+		SetIsa(isa);
+		this->threadCount = threadCount;
+		Resize(width, height);
+	}
+	// Reallocates the accumulation and tiles for a new image size, e.g. with the window. Restarts accumulation.
+	void Resize(unsigned int width, unsigned int height) {
+		this->width = width;
+		this->height = height;
+
+		accumulation.assign((size_t)width * height * 4, 0.0f);
+
+		context.width = width;
+		context.height = height;
+		context.accumulation = accumulation.data();
+
+		tiles.clear();
+		for (unsigned int y = 0; y < height; y += TILE_SIZE) {
+			for (unsigned int x = 0; x < width; x += TILE_SIZE) {
+				tiles.push_back(CpuTile{ x, y, glm::min(x + TILE_SIZE, width), glm::min(y + TILE_SIZE, height) });
+			}
+		}
+		// The costs it learned belong to the old tiles.
+		scheduler.reset();
+		scheduler.reset(new TileScheduler(tiles.size(), threadCount));
+		ResetAccumulation();
+	}
+	// Falls back to the widest supported instruction set when the requested one is unavailable.
+	void SetIsa(Isa isa) {
+		if (!CpuFeatures::IsSupported(isa)) isa = CpuFeatures::DetectIsa();
+		this->isa = isa;
+
+		if (isa == Isa::avx512) renderTile = RenderTileAVX512;
+		else if (isa == Isa::avx2) renderTile = RenderTileAVX2;
+		else renderTile = RenderTileScalar;
+	}
+	Isa GetIsa() {
+		return isa;
+	}
+	void SetVolume(Volume& volume) {
+		context.volumeMin = volume.cornerMin;
+		context.volumeMax = volume.cornerMax;
+		context.volumeCenter = (volume.cornerMin + volume.cornerMax) / 2.0f;
+		context.stepCount = volume.stepCount;
+	}
+	// Restarts accumulation whenever the camera has moved since the last call.
+	void SetCamera(Camera& camera) {
+		if (lastCameraModelMatrix != camera.GetModelMatrix()) {
+			ResetAccumulation();
+			lastCameraModelMatrix = camera.GetModelMatrix();
+		}
+		context.cameraPos = camera.GetPosition();
+		context.cameraXAxis = camera.GetXAxis();
+		context.cameraYAxis = camera.GetYAxis();
+		context.cameraZAxis = camera.GetZAxis();
+		context.cameraFocalLength = camera.GetFocalLength();
+	}
+	void ResetAccumulation() {
+		sampleNum = 1.0f;
+	}
+	// RNG stream of the first sample after a reset, see Renderer::SetSampleOffset().
+	void SetSampleOffset(unsigned int sampleOffset) {
+		this->sampleOffset = sampleOffset;
+	}
+	void Render() {
+		context.sampleNum = sampleNum;
+		context.sampleIndex = sampleOffset + (uint32_t)sampleNum - 1;
+
+		scheduler->Run([this](size_t tile) {
+			renderTile(context, tiles[tile]);
+		});
+
+		sampleNum++;
+	}
+	// Renders one fresh sample for rows [y0, y1) without touching the sample count, for when the GPU
+	// owns the accumulation (hybrid mode). Both rows must lie on tile boundaries or the image edge.
+	void RenderSample(unsigned int y0, unsigned int y1, uint32_t sampleIndex) {
+		size_t tilesPerRow = (width + TILE_SIZE - 1) / TILE_SIZE;
+		size_t begin = y0 / TILE_SIZE * tilesPerRow;
+		size_t end = (y1 + TILE_SIZE - 1) / TILE_SIZE * tilesPerRow;
+
+		// Sample one of the accumulation writes the plain sample value.
+		context.sampleNum = 1.0f;
+		context.sampleIndex = sampleIndex;
+		scheduler->Run(begin, end, [this](size_t tile) {
+			renderTile(context, tiles[tile]);
+		});
+	}
+	// Normalized linear radiance, bottom row first, like Renderer::ReadLinearOutput().
+	Image ReadLinearOutput() {
+		Image image = Image(width, height);
+		for (size_t i = 0; i < (size_t)width * height; i++) {
+			const float* pixel = &accumulation[i * 4];
+			float normalization = 1.0f / glm::max(pixel[3], 1.0f);
+			for (int c = 0; c < 3; c++) image.pixels[i * 3 + c] = pixel[c] * normalization;
+		}
+		return image;
+	}
+	std::vector<float>& GetAccumulation() {
+		return accumulation;
+	}
+	unsigned int GetSampleCount() {
+		return (unsigned int)sampleNum - 1;
+	}
+	TileScheduler& GetScheduler() {
+		return *scheduler;
+	}
+private:
+	unsigned int width, height;
+	unsigned int threadCount;
+	Isa isa;
+	void (*renderTile)(const CpuRenderContext&, const CpuTile&);
+
+	CpuRenderContext context;
+	std::vector<float> accumulation;
+	std::vector<CpuTile> tiles;
+	std::unique_ptr<TileScheduler> scheduler;
+
+	float sampleNum = 1.0f;
+	unsigned int sampleOffset = 0;
+	glm::mat4 lastCameraModelMatrix = glm::mat4(0.0f);
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <glad/glad.h>
+
+enum class DebugOutputMode {
+	// Messages arrive on the thread of the call that caused them, for breakpoints in the callback.
+	synchronous,
+	// The driver reports whenever it likes, without serializing the pipeline.
+	asynchronous,
+	off
+};
+
+// GL debug output that never blocks the driver: the callback only copies the message into a bounded
+// lock-free queue, and a background thread writes them. The first few messages of every id are
+// written in full; after that an id is only summarized, at most once per REPEAT_INTERVAL.
+class DebugLog {
+public:
+	static const size_t QUEUE_CAPACITY = 1024;
+	// Queue cells only high severity messages may take, so a flood of warnings cannot crowd out errors.
+	static const size_t RESERVED_FOR_HIGH = QUEUE_CAPACITY / 4;
+	static const size_t MESSAGE_LENGTH = 512;
+	// Messages of one id written in full before it is only counted.
+	static const unsigned int FULL_REPEATS = 3;
+	static constexpr double REPEAT_INTERVAL = 1.0;
+#ifdef NDEBUG
+	static const DebugOutputMode DEFAULT_MODE = DebugOutputMode::asynchronous;
+#else
+	static const DebugOutputMode DEFAULT_MODE = DebugOutputMode::synchronous;
+#endif
+public:
+	static DebugLog& Get() {
+		static DebugLog log;
+		return log;
+	}
+	// Hooks the current context up to the log.
+	void Attach(DebugOutputMode mode) {
+		if (mode == DebugOutputMode::off) {
+			glDisable(GL_DEBUG_OUTPUT);
+			glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(writerMutex);
+			if (!writer.joinable()) writer = std::thread(&DebugLog::WriterLoop, this);
+		}
+		glDebugMessageCallback(Callback, this);
+		glEnable(GL_DEBUG_OUTPUT);
+		if (mode == DebugOutputMode::synchronous) glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		else glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+	// Writes everything queued so far, including pending repeat counts.
+	void Flush() {
+		std::lock_guard<std::mutex> lock(writerMutex);
+		Drain(true);
+	}
+	static bool ParseMode(const std::string& name, DebugOutputMode& mode) {
+		if (name == "sync") mode = DebugOutputMode::synchronous;
+		else if (name == "async") mode = DebugOutputMode::asynchronous;
+		else if (name == "off") mode = DebugOutputMode::off;
+		else return false;
+		return true;
+	}
+private:
+	struct Message {
+		GLenum source, type, severity;
+		unsigned int id;
+		char text[MESSAGE_LENGTH];
+	};
+	// Bounded multi-producer queue: a cell is free for the producer whose ticket matches its sequence,
+	// and ready for the consumer once the producer has advanced it by one.
+	struct Cell {
+		std::atomic<size_t> sequence;
+		Message message;
+	};
+	struct Repeats {
+		unsigned int count = 0;
+		// Repeats written as a count only, not yet reported.
+		unsigned int unreported = 0;
+		std::chrono::steady_clock::time_point lastReport;
+		std::string lastText;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	std::atomic<size_t> enqueueTicket{ 0 };
+	std::atomic<size_t> dequeueTicket{ 0 };
+	std::atomic<unsigned int> droppedCount{ 0 };
+
+	std::thread writer;
+	bool stopping = false;
+	// Held while draining; the writer thread and Flush() take turns.
+	std::mutex writerMutex;
+	std::condition_variable wakeCondition;
+	std::map<std::tuple<GLenum, GLenum, unsigned int>, Repeats> repeats;
+private:
+	DebugLog() {
+		cells.reset(new Cell[QUEUE_CAPACITY]);
+		for (size_t i = 0; i < QUEUE_CAPACITY; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	~DebugLog() {
+		{
+			std::lock_guard<std::mutex> lock(writerMutex);
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		if (writer.joinable()) writer.join();
+		Drain(true);
+	}
+
+	static void APIENTRY Callback(GLenum source, GLenum type, unsigned int id, GLenum severity, GLsizei length, const char* message, const void* userParam) {
+		// Non-significant NVIDIA notifications about buffer placement and shader recompiles.
+		if (id == 131169 || id == 131185 || id == 131218 || id == 131204) return;
+		((DebugLog*)userParam)->Push(source, type, id, severity, length, message);
+	}
+	// Never blocks or allocates; when the writer has fallen too far behind, the message is dropped and counted.
+	void Push(GLenum source, GLenum type, unsigned int id, GLenum severity, GLsizei length, const char* text) {
+		size_t ticket = enqueueTicket.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true) {
+			if (severity != GL_DEBUG_SEVERITY_HIGH && ticket - dequeueTicket.load(std::memory_order_relaxed) >= QUEUE_CAPACITY - RESERVED_FOR_HIGH) {
+				droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			cell = &cells[ticket % QUEUE_CAPACITY];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			if (sequence == ticket) {
+				if (enqueueTicket.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) break;
+			}
+			else if (sequence < ticket) {
+				droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			else ticket = enqueueTicket.load(std::memory_order_relaxed);
+		}
+		Message& message = cell->message;
+		message.source = source;
+		message.type = type;
+		message.id = id;
+		message.severity = severity;
+		size_t size = length >= 0 ? (size_t)length : strlen(text);
+		size = std::min(size, MESSAGE_LENGTH - 1);
+		memcpy(message.text, text, size);
+		message.text[size] = '\0';
+		cell->sequence.store(ticket + 1, std::memory_order_release);
+
+		if (severity == GL_DEBUG_SEVERITY_HIGH) wakeCondition.notify_one();
+	}
+	void WriterLoop() {
+		std::unique_lock<std::mutex> lock(writerMutex);
+		while (!stopping) {
+			wakeCondition.wait_for(lock, std::chrono::milliseconds(100));
+			Drain(false);
+		}
+	}
+	// Writer side, with writerMutex held.
+	void Drain(bool reportRepeats) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		bool wrote = false;
+		while (true) {
+			size_t ticket = dequeueTicket.load(std::memory_order_relaxed);
+			Cell& cell = cells[ticket % QUEUE_CAPACITY];
+			if (cell.sequence.load(std::memory_order_acquire) != ticket + 1) break;
+			Message& message = cell.message;
+
+			Repeats& repeat = repeats[std::make_tuple(message.source, message.type, message.id)];
+			repeat.count++;
+			if (repeat.count <= FULL_REPEATS) {
+				Write(message);
+				if (repeat.count == FULL_REPEATS) std::cout << "  (further messages with id " << message.id << " are only counted)\n";
+				repeat.lastReport = now;
+				wrote = true;
+			}
+			else {
+				repeat.unreported++;
+				repeat.lastText = message.text;
+			}
+			cell.sequence.store(ticket + QUEUE_CAPACITY, std::memory_order_release);
+			dequeueTicket.store(ticket + 1, std::memory_order_relaxed);
+		}
+		for (std::pair<const std::tuple<GLenum, GLenum, unsigned int>, Repeats>& entry : repeats) {
+			Repeats& repeat = entry.second;
+			if (!repeat.unreported) continue;
+			if (!reportRepeats && std::chrono::duration<double>(now - repeat.lastReport).count() < REPEAT_INTERVAL) continue;
+			std::cout << "GL message " << std::get<2>(entry.first) << " repeated " << repeat.unreported << " more times, last: " << repeat.lastText << "\n";
+			repeat.unreported = 0;
+			repeat.lastReport = now;
+			wrote = true;
+		}
+		unsigned int dropped = droppedCount.exchange(0, std::memory_order_relaxed);
+		if (dropped) {
+			std::cout << "GL debug log fell behind: " << dropped << " messages dropped\n";
+			wrote = true;
+		}
+		if (wrote) std::cout.flush();
+	}
+	static void Write(const Message& message) {
+		std::cout << "GL " << GetSeverityName(message.severity) << " " << GetTypeName(message.type) << " from " << GetSourceName(message.source)
+			<< " (" << message.id << "): " << message.text << "\n";
+	}
+	static const char* GetSourceName(GLenum source) {
+		switch (source) {
+		case GL_DEBUG_SOURCE_API:             return "API";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   return "window system";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY:     return "third party";
+		case GL_DEBUG_SOURCE_APPLICATION:     return "application";
+		}
+		return "other";
+	}
+	static const char* GetTypeName(GLenum type) {
+		switch (type) {
+		case GL_DEBUG_TYPE_ERROR:               return "error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behaviour";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "undefined behaviour";
+		case GL_DEBUG_TYPE_PORTABILITY:         return "portability";
+		case GL_DEBUG_TYPE_PERFORMANCE:         return "performance";
+		case GL_DEBUG_TYPE_MARKER:              return "marker";
+		case GL_DEBUG_TYPE_PUSH_GROUP:          return "push group";
+		case GL_DEBUG_TYPE_POP_GROUP:           return "pop group";
+		}
+		return "other";
+	}
+	static const char* GetSeverityName(GLenum severity) {
+		switch (severity) {
+		case GL_DEBUG_SEVERITY_HIGH:         return "high";
+		case GL_DEBUG_SEVERITY_MEDIUM:       return "medium";
+		case GL_DEBUG_SEVERITY_LOW:          return "low";
+		}
+		return "notification";
+	}
+};
@@ -0,0 +1,266 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+#include <stb_image/stb_image.h>
+#include <glad/glad.h>
+
+#include "RenderMode.h"
+#include "HDRReader.h"
+#include "BC6HEncoder.h"
+#include "Octahedral.h"
+#include "MappedFile.h"
+#include "TemporaryPath.h"
+#include "TileScheduler.h"
+#include "Profiler.h"
+
+// An environment map ready for upload: one entry per mip level, pointing into whichever of pixels,
+// encoded or file holds the data.
+struct EnvironmentMapData {
+	struct Level {
+		const uint8_t* data;
+		size_t size;
+		int width, height;
+	};
+	EnvironmentFormat format = EnvironmentFormat::rgb32f;
+	std::vector<Level> levels;
+
+	std::vector<float> pixels;
+	std::vector<uint8_t> encoded;
+	MappedFile file;
+
+	GLenum GetInternalFormat() const {
+		return format == EnvironmentFormat::bc6h ? GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT : GL_RGB32F;
+	}
+	bool IsCompressed() const {
+		return format == EnvironmentFormat::bc6h;
+	}
+	// Compressed levels can only be uploaded in whole rows of blocks.
+	int GetRowGranularity() const {
+		return IsCompressed() ? 4 : 1;
+	}
+	// Bytes of one row, or of one row of blocks for compressed levels.
+	size_t GetRowSize(size_t level) const {
+		int width = levels[level].width;
+		return IsCompressed() ? BC6H::GetSize(width, 1) : (size_t)width * 3 * sizeof(float);
+	}
+	// Uploads rows [y, y + rowCount) of a level to texture from data, or from that offset into the bound
+	// pixel unpack buffer. y is a multiple of the row granularity.
+	void UploadRows(GLuint texture, size_t level, int y, int rowCount, const void* data) const {
+		int width = levels[level].width;
+		if (IsCompressed()) {
+			size_t size = GetRowSize(level) * ((rowCount + 3) / 4);
+			glCompressedTextureSubImage2D(texture, (GLint)level, 0, y, width, rowCount, GetInternalFormat(), (GLsizei)size, data);
+		}
+		else {
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glTextureSubImage2D(texture, (GLint)level, 0, y, width, rowCount, GL_RGB, GL_FLOAT, data);
+		}
+	}
+	// Drops the level data once it is on the GPU.
+	void Release() {
+		levels.clear();
+		std::vector<float>().swap(pixels);
+		std::vector<uint8_t>().swap(encoded);
+		file.Close();
+	}
+};
+
+// Converts equirectangular environment maps to octahedral ones (see Octahedral.h) with a full mip
+// chain, in their GPU format. BC6H maps are built once and kept in a cache file next to the source,
+// which later runs map and hand straight to glCompressedTextureSubImage2D(); they take 1 byte per
+// texel against 12 for RGB32F. The cache is rebuilt when the source's size or modification time no
+// longer match the ones recorded in it. RGB32F maps are built in memory on every load.
+//
+//	"CLRENV02", then uint64 format, width, height, levelCount, sourceSize, sourceTime, then per level
+//	uint64 offset and size from the start of the file, then the levels, largest first.
+class EnvironmentCache {
+public:
+	// Safe to call from any thread.
+	static bool Load(const std::string& sourcePath, EnvironmentFormat format, EnvironmentMapData& data) {
+		data.format = format;
+		if (format == EnvironmentFormat::rgb32f) return Build(sourcePath, data);
+
+		std::string cachePath = GetCachePath(sourcePath);
+		uint64_t sourceSize, sourceTime;
+		if (!GetFileStamp(sourcePath, sourceSize, sourceTime)) {
+			std::cout << "ERROR: Could not find enviroment map with path <" << sourcePath << ">" << std::endl;
+			return false;
+		}
+		if (Map(cachePath, format, sourceSize, sourceTime, data)) return true;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!Build(sourcePath, data)) return false;
+		if (Write(cachePath, format, sourceSize, sourceTime, data) && Map(cachePath, format, sourceSize, sourceTime, data)) {
+			std::vector<uint8_t>().swap(data.encoded);
+		}
+		std::cout << "Built environment map cache <" << cachePath << "> in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+		return true;
+	}
+	static std::string GetCachePath(const std::string& sourcePath) {
+		return sourcePath + ".bc6h.cache";
+	}
+	// Decodes an environment map into RGB rows, bottom row first as GL expects. Radiance files go through
+	// HDRReader, anything else through stb_image. Safe to call from any thread.
+	static bool Decode(const std::string& sourcePath, std::vector<float>& pixels, int& width, int& height) {
+		if (HDRReader::IsRadiance(sourcePath)) return HDRReader::Read(sourcePath, pixels, width, height);
+
+		stbi_set_flip_vertically_on_load_thread(true);
+		int numChannels;
+		float* data = stbi_loadf(sourcePath.c_str(), &width, &height, &numChannels, 3);
+		stbi_set_flip_vertically_on_load_thread(false);
+
+		if (!data) {
+			std::cout << "ERROR: Could not load enviroment map with path <" << sourcePath << ">" << std::endl;
+			return false;
+		}
+		pixels.assign(data, data + (size_t)width * height * 3);
+		stbi_image_free(data);
+		return true;
+	}
+private:
+	static const size_t HEADER_SIZE = 8 + 6 * sizeof(uint64_t);
+	// Rows of blocks encoded as one task.
+	static const int BLOCK_ROWS = 8;
+private:
+	static const char* Magic() {
+		return "CLRENV02";
+	}
+	static bool GetFileStamp(const std::string& path, uint64_t& size, uint64_t& time) {
+		struct stat status;
+		if (stat(path.c_str(), &status) != 0) return false;
+		size = (uint64_t)status.st_size;
+		time = (uint64_t)status.st_mtime;
+		return true;
+	}
+	// Maps a cache file and checks it against the source. A missing or stale cache is not an error.
+	static bool Map(const std::string& cachePath, EnvironmentFormat format, uint64_t sourceSize, uint64_t sourceTime, EnvironmentMapData& data) {
+		uint64_t sizeOnDisk, timeOnDisk;
+		if (!GetFileStamp(cachePath, sizeOnDisk, timeOnDisk) || sizeOnDisk < HEADER_SIZE) return false;
+
+		PROFILE_ZONE("Map environment map cache");
+		MappedFile& file = data.file;
+		if (!file.Open(cachePath)) return false;
+		const uint8_t* bytes = file.GetData();
+		uint64_t header[6];
+		memcpy(header, bytes + 8, sizeof(header));
+		size_t levelCount = (size_t)header[3];
+		if (memcmp(bytes, Magic(), 8) != 0 || header[0] != (uint64_t)format || header[4] != sourceSize || header[5] != sourceTime
+			|| levelCount == 0 || HEADER_SIZE + levelCount * 2 * sizeof(uint64_t) > file.GetSize()) {
+			file.Close();
+			return false;
+		}
+		std::vector<EnvironmentMapData::Level> levels;
+		int width = (int)header[1], height = (int)header[2];
+		for (size_t i = 0; i < levelCount; i++) {
+			uint64_t table[2];
+			memcpy(table, bytes + HEADER_SIZE + i * sizeof(table), sizeof(table));
+			if (table[0] + table[1] > file.GetSize() || table[1] != BC6H::GetSize(width, height)) {
+				std::cout << "ERROR: Environment map cache <" << cachePath << "> is corrupt, rebuilding it" << std::endl;
+				file.Close();
+				return false;
+			}
+			levels.push_back({ bytes + table[0], (size_t)table[1], width, height });
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+		}
+		data.levels = levels;
+		return true;
+	}
+	static size_t GetLevelSize(EnvironmentFormat format, int width, int height) {
+		return format == EnvironmentFormat::bc6h ? BC6H::GetSize(width, height) : (size_t)width * height * 3 * sizeof(float);
+	}
+	// Decodes the source, converts it to an octahedral map, filters the mip chain and stores every
+	// level in data.encoded, or data.pixels for RGB32F.
+	static bool Build(const std::string& sourcePath, EnvironmentMapData& data) {
+		PROFILE_ZONE("Build environment map");
+		std::vector<float> pixels, weights;
+		int size;
+		{
+			std::vector<float> equirect;
+			int width, height;
+			if (!Decode(sourcePath, equirect, width, height)) return false;
+			size = Octahedral::GetSize(height);
+			Octahedral::FromEquirect(equirect, width, height, size, pixels);
+		}
+		Octahedral::GetSolidAngleWeights(size, weights);
+
+		std::vector<size_t> offsets;
+		size_t total = 0;
+		for (int levelSize = size; ; levelSize /= 2) {
+			offsets.push_back(total);
+			total += GetLevelSize(data.format, levelSize, levelSize);
+			if (levelSize == 1) break;
+		}
+		uint8_t* base;
+		if (data.IsCompressed()) {
+			data.encoded.resize(total);
+			base = data.encoded.data();
+		}
+		else {
+			data.pixels.resize(total / sizeof(float));
+			base = (uint8_t*)data.pixels.data();
+		}
+		data.levels.clear();
+
+		for (size_t level = 0; level < offsets.size(); level++) {
+			if (level > 0) Octahedral::Downsample(pixels, weights, size);
+			uint8_t* out = base + offsets[level];
+			if (data.IsCompressed()) {
+				int blockRows = (size + 3) / 4;
+				TileScheduler scheduler((blockRows + BLOCK_ROWS - 1) / BLOCK_ROWS);
+				scheduler.Run([&](size_t task) {
+					int begin = (int)task * BLOCK_ROWS;
+					BC6H::Encode(pixels.data(), size, size, begin, std::min(blockRows, begin + BLOCK_ROWS), out);
+				});
+			}
+			else memcpy(out, pixels.data(), pixels.size() * sizeof(float));
+			data.levels.push_back({ out, GetLevelSize(data.format, size, size), size, size });
+		}
+		return true;
+	}
+	// Written next to the destination and renamed into place, so readers never see a partial file.
+	static bool Write(const std::string& cachePath, EnvironmentFormat format, uint64_t sourceSize, uint64_t sourceTime, const EnvironmentMapData& data) {
+		std::string temporaryPath = GetTemporaryPath(cachePath);
+		std::ofstream file = std::ofstream(temporaryPath, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write environment map cache <" << temporaryPath << ">" << std::endl;
+			return false;
+		}
+		uint64_t header[6] = { (uint64_t)format, (uint64_t)data.levels[0].width, (uint64_t)data.levels[0].height, data.levels.size(), sourceSize, sourceTime };
+		file.write(Magic(), 8);
+		file.write((const char*)header, sizeof(header));
+		uint64_t offset = HEADER_SIZE + data.levels.size() * 2 * sizeof(uint64_t);
+		for (const EnvironmentMapData::Level& level : data.levels) {
+			uint64_t table[2] = { offset, level.size };
+			file.write((const char*)table, sizeof(table));
+			offset += level.size;
+		}
+		for (const EnvironmentMapData::Level& level : data.levels) file.write((const char*)level.data, level.size);
+		file.close();
+		if (file.fail()) {
+			std::cout << "ERROR: Could not write environment map cache <" << temporaryPath << ">" << std::endl;
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+		// rename() does not replace an existing file on Windows. Elsewhere it replaces it atomically, so
+		// readers see either the old file or the new one.
+#if defined(_MSC_VER)
+		std::remove(cachePath.c_str());
+#endif
+		if (std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+			std::remove(temporaryPath.c_str());
+			std::cout << "ERROR: Could not move environment map cache into place at <" << cachePath << ">" << std::endl;
+			return false;
+		}
+		return true;
+	}
+};
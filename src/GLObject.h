@@ -0,0 +1,77 @@
+#pragma once
+#include <glad/glad.h>
+
+// Owns one GL object name and deletes it along with itself, so GPU resources follow the lifetime
+// of whatever holds them. Move-only; a default constructed or moved-from object owns nothing. Must
+// be destroyed while its context is current.
+template<class Deleter> class GLObject {
+public:
+	GLObject() {}
+	explicit GLObject(GLuint id) {
+		this->id = id;
+	}
+	~GLObject() {
+		Reset();
+	}
+	GLObject(const GLObject&) = delete;
+	GLObject& operator=(const GLObject&) = delete;
+	GLObject(GLObject&& other) {
+		id = other.id;
+		other.id = 0;
+	}
+	GLObject& operator=(GLObject&& other) {
+		if (this != &other) {
+			Reset(other.id);
+			other.id = 0;
+		}
+		return *this;
+	}
+	GLuint Get() const {
+		return id;
+	}
+	// Deletes the current object, if any, and takes ownership of id.
+	void Reset(GLuint id = 0) {
+		if (this->id) Deleter::Delete(this->id);
+		this->id = id;
+	}
+private:
+	GLuint id = 0;
+};
+
+struct TextureDeleter {
+	static void Delete(GLuint id) {
+		glDeleteTextures(1, &id);
+	}
+};
+struct BufferDeleter {
+	static void Delete(GLuint id) {
+		glDeleteBuffers(1, &id);
+	}
+};
+struct VertexArrayDeleter {
+	static void Delete(GLuint id) {
+		glDeleteVertexArrays(1, &id);
+	}
+};
+struct QueryDeleter {
+	static void Delete(GLuint id) {
+		glDeleteQueries(1, &id);
+	}
+};
+struct ShaderDeleter {
+	static void Delete(GLuint id) {
+		glDeleteShader(id);
+	}
+};
+struct ProgramDeleter {
+	static void Delete(GLuint id) {
+		glDeleteProgram(id);
+	}
+};
+
+typedef GLObject<TextureDeleter> TextureObject;
+typedef GLObject<BufferDeleter> BufferObject;
+typedef GLObject<VertexArrayDeleter> VertexArrayObject;
+typedef GLObject<QueryDeleter> QueryObject;
+typedef GLObject<ShaderDeleter> ShaderObject;
+typedef GLObject<ProgramDeleter> ProgramObject;
@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 enum class Space {
 	local,
@@ -22,9 +23,19 @@ public:
 		if (space == Space::global) axis = glm::normalize(glm::inverse(rotationMatrix) * glm::vec4(axis, 0));
 		rotationMatrix = glm::rotate(rotationMatrix, glm::radians(angleInDegrees), axis);
 	}
+	void SetPosition(glm::vec3 position) {
+		this->position = position;
+		translationMatrix = glm::translate(glm::mat4(1.0f), position);
+	}
 	glm::vec3 GetPosition() {
 		return position;
 	}
+	void SetRotation(glm::quat rotation) {
+		rotationMatrix = glm::mat4_cast(rotation);
+	}
+	glm::quat GetRotation() {
+		return glm::quat_cast(rotationMatrix);
+	}
 	glm::mat4 GetModelMatrix() {
 		return translationMatrix * scaleMatrix * rotationMatrix;
 	}
@@ -0,0 +1,102 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Renderer.h"
+#include "CpuRenderer.h"
+#include "SceneDescription.h"
+#include "WindowInfo.h"
+#include "Benchmark.h"
+#include "ImageReader.h"
+#include "ImageWriter.h"
+#include "ImageMetrics.h"
+
+struct GoldenComparison {
+	// "<view>: <image> vs <reference>"
+	std::string name;
+	// Largest error in units of the tolerance; within tolerance up to 1.
+	float maxError = 0.0f;
+	size_t failedPixelCount = 0;
+	std::string heatmapPath;
+
+	bool Passed() const {
+		return failedPixelCount == 0;
+	}
+};
+
+// Regression test for the renderers: the benchmark views are rendered at a small fixed size with a
+// fixed sample count and RNG streams, once through Render.comp and once through the CPU reference
+// kernel, and both are compared per pixel with stored golden images and with each other. Goldens
+// come from the CPU path, which does not depend on the driver. Every comparison writes a heatmap of
+// the error in units of the tolerance.
+class GoldenTest {
+public:
+	static const unsigned int WIDTH = 160, HEIGHT = 90;
+public:
+	// The benchmark views at WIDTH x HEIGHT, without the extra resolutions; the default one is named "view".
+	static std::vector<BenchmarkScenario> GetScenarios(const SceneDescription& base) {
+		std::vector<BenchmarkScenario> scenarios;
+		for (BenchmarkScenario& scenario : Benchmark::GetScenarios(base, 1.0f)) {
+			if (scenario.scene.width != 1280 || scenario.scene.height != 720) continue;
+			scenario.scene.width = WIDTH;
+			scenario.scene.height = HEIGHT;
+			// Render.comp does not sample the environment map, so the goldens need no HDRI.
+			scenario.scene.environmentMapPath.clear();
+			if (scenario.name.compare(0, 5, "view-") == 0) scenario.name = "view";
+			scenarios.push_back(scenario);
+		}
+		return scenarios;
+	}
+	static std::string GetGoldenPath(const std::string& prefix, const BenchmarkScenario& scenario) {
+		return prefix + "_" + scenario.name + ".pfm";
+	}
+	// Offline accumulation from sample index 0. Needs a current GL context.
+	static Image RenderGpu(const BenchmarkScenario& scenario, unsigned int sampleCount) {
+		SceneDescription scene = scenario.scene;
+		Renderer renderer(scene.width, scene.height, RenderMode::offline, scene.environmentMapPath);
+		renderer.SetPresenting(false);
+
+		Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+		Volume volume = scene.CreateVolume();
+		renderer.SetVolume(volume);
+		renderer.SetCamera(camera);
+		while (renderer.GetSampleCount() < sampleCount) renderer.Render(scene.time);
+		return renderer.ReadLinearOutput();
+	}
+	static Image RenderCpu(const BenchmarkScenario& scenario, unsigned int sampleCount, Isa isa, unsigned int threadCount) {
+		SceneDescription scene = scenario.scene;
+		CpuRenderer renderer(scene.width, scene.height, isa, threadCount);
+
+		Camera camera = scene.CreateCamera(WindowInfo(nullptr, scene.width, scene.height));
+		Volume volume = scene.CreateVolume();
+		renderer.SetVolume(volume);
+		renderer.SetCamera(camera);
+		while (renderer.GetSampleCount() < sampleCount) renderer.Render();
+		return renderer.ReadLinearOutput();
+	}
+	// A pixel fails when any channel differs from the reference by more than absolute + relative * |reference|.
+	static GoldenComparison Compare(const std::string& name, const Image& image, const Image& reference, float absolute, float relative, const std::string& heatmapPath) {
+		GoldenComparison comparison;
+		comparison.name = name;
+		comparison.heatmapPath = heatmapPath;
+		if (image.width != reference.width || image.height != reference.height) {
+			std::cout << "ERROR: " << name << ": " << image.width << "x" << image.height << " against a "
+				<< reference.width << "x" << reference.height << " reference" << std::endl;
+			comparison.failedPixelCount = (size_t)image.width * image.height;
+			comparison.maxError = 2.0f;
+			comparison.heatmapPath.clear();
+			return comparison;
+		}
+		std::vector<float> errors = ImageMetrics::ToleranceMap(image, reference, absolute, relative);
+		for (float error : errors) {
+			comparison.maxError = std::max(comparison.maxError, error);
+			if (error > 1.0f) comparison.failedPixelCount++;
+		}
+		if (!heatmapPath.empty() && !ImageWriter::WritePNG(heatmapPath, image.width, image.height, ImageMetrics::Heatmap(errors, image.width, image.height))) {
+			comparison.heatmapPath.clear();
+		}
+		return comparison;
+	}
+};
@@ -0,0 +1,9 @@
+#include "HDRReader.h"
+
+#if !defined(__AVX2__)
+#error "HDRKernelAVX2.cpp must be compiled with AVX2 code generation enabled"
+#endif
+
+void RGBEToFloatAVX2(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count) {
+	RGBE::ToFloatPackets<Float8>(r, g, b, e, rgb, count);
+}
@@ -0,0 +1,9 @@
+#include "HDRReader.h"
+
+#if !defined(__AVX512F__)
+#error "HDRKernelAVX512.cpp must be compiled with AVX512 code generation enabled"
+#endif
+
+void RGBEToFloatAVX512(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count) {
+	RGBE::ToFloatPackets<Float16>(r, g, b, e, rgb, count);
+}
@@ -0,0 +1,5 @@
+#include "HDRReader.h"
+
+void RGBEToFloatScalar(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count) {
+	RGBE::ToFloatPackets<Float1>(r, g, b, e, rgb, count);
+}
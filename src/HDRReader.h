@@ -0,0 +1,258 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "Simd.h"
+#include "CpuFeatures.h"
+#include "MappedFile.h"
+#include "TileScheduler.h"
+
+// RGBE to float conversion. Decodes to m * 2^(e - 136), and 0 for e = 0, like stb_image, so maps
+// read either way are identical.
+namespace RGBE {
+	template<class F> F Decode(F mantissa, F exponent) {
+		// Split in two so neither factor leaves the normal range; the product may be denormal.
+		F scale = Pow2i(Max(exponent - F(136.0f), F(-126.0f))) * Pow2i(Min(exponent - F(10.0f), F(0.0f)));
+		return Select(exponent < F(1.0f), F(0.0f), mantissa * scale);
+	}
+	// Converts count pixels from separate r, g, b and e byte planes, as RLE scanlines store them, to
+	// interleaved RGB floats, F::width at a time. The tail is padded into one last packet like
+	// Noise::CNoisePackets(), so no Float1 code is instantiated in the wide translation units.
+	template<class F> void ToFloatPackets(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count) {
+		size_t i = 0;
+		for (; i + F::width <= count; i += F::width) {
+			F exponent = F::LoadBytes(e + i);
+			StoreInterleaved3(rgb + 3 * i, Decode(F::LoadBytes(r + i), exponent), Decode(F::LoadBytes(g + i), exponent), Decode(F::LoadBytes(b + i), exponent));
+		}
+		if (i == count) return;
+
+		uint8_t tail[4][F::width] = {};
+		float out[3 * F::width];
+		for (size_t j = i; j < count; j++) {
+			tail[0][j - i] = r[j];
+			tail[1][j - i] = g[j];
+			tail[2][j - i] = b[j];
+			tail[3][j - i] = e[j];
+		}
+		F exponent = F::LoadBytes(tail[3]);
+		StoreInterleaved3(out, Decode(F::LoadBytes(tail[0]), exponent), Decode(F::LoadBytes(tail[1]), exponent), Decode(F::LoadBytes(tail[2]), exponent));
+		memcpy(rgb + 3 * i, out, 3 * (count - i) * sizeof(float));
+	}
+
+	typedef void (*ToFloatFunction)(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count);
+}
+
+// Per instruction set conversion entry points, built in their own translation units like the render kernels.
+void RGBEToFloatScalar(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count);
+void RGBEToFloatAVX2(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count);
+void RGBEToFloatAVX512(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count);
+
+namespace RGBE {
+	inline ToFloatFunction GetToFloatFunction(Isa isa) {
+		if (!CpuFeatures::IsSupported(isa)) isa = CpuFeatures::DetectIsa();
+
+		if (isa == Isa::avx512) return RGBEToFloatAVX512;
+		if (isa == Isa::avx2) return RGBEToFloatAVX2;
+		return RGBEToFloatScalar;
+	}
+	// Dispatched once to the widest instruction set available.
+	inline void ToFloat(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* e, float* rgb, size_t count) {
+		static const ToFloatFunction toFloatFunction = GetToFloatFunction(CpuFeatures::DetectIsa());
+		toFloatFunction(r, g, b, e, rgb, count);
+	}
+}
+
+// Reader for Radiance .hdr environment maps. The file is memory-mapped and a quick pass over the
+// run lengths finds where every scanline starts; blocks of scanlines are then decoded in parallel
+// and converted to floats with RGBEToFloat. The result is RGB floats with rows bottom up, ready for
+// glTextureSubImage2D(..., GL_RGB, GL_FLOAT, ...).
+class HDRReader {
+public:
+	// Scanlines decoded as one task.
+	static const int BLOCK_ROWS = 32;
+public:
+	// True if the file starts with the Radiance signature.
+	static bool IsRadiance(const std::string& path) {
+		char signature[10] = {};
+		std::ifstream file = std::ifstream(path, std::ios::binary);
+		file.read(signature, sizeof(signature));
+		return HasSignature((const uint8_t*)signature, (size_t)file.gcount());
+	}
+	// Decodes on threadCount threads, every hardware thread for 0.
+	static bool Read(const std::string& path, std::vector<float>& pixels, int& width, int& height, unsigned int threadCount = 0) {
+		MappedFile file;
+		if (!file.Open(path)) return false;
+		if (!Decode(file.GetData(), file.GetSize(), pixels, width, height, threadCount)) {
+			std::cout << "ERROR: Could not decode Radiance file <" << path << ">" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	static bool Decode(const uint8_t* data, size_t size, std::vector<float>& pixels, int& width, int& height, unsigned int threadCount = 0) {
+		size_t position = 0;
+		if (!ReadHeader(data, size, position, width, height)) return false;
+
+		std::vector<size_t> scanlineOffsets;
+		bool runLengthEncoded = IsRunLengthEncoded(data + position, size - position, width);
+		if (runLengthEncoded) {
+			if (!IndexScanlines(data, size, position, width, height, scanlineOffsets)) return false;
+		}
+		else if (size - position < (size_t)width * height * 4) {
+			std::cout << "ERROR: Radiance file is truncated" << std::endl;
+			return false;
+		}
+
+		pixels.resize((size_t)width * height * 3);
+		size_t blockCount = (height + BLOCK_ROWS - 1) / BLOCK_ROWS;
+		std::atomic<bool> failed{ false };
+		TileScheduler scheduler(blockCount, threadCount);
+		scheduler.Run([&](size_t block) {
+			std::vector<uint8_t> planes((size_t)width * 4);
+			uint8_t* r = planes.data();
+			uint8_t* g = r + width;
+			uint8_t* b = g + width;
+			uint8_t* e = b + width;
+			int end = std::min(height, (int)(block + 1) * BLOCK_ROWS);
+			for (int y = (int)block * BLOCK_ROWS; y < end; y++) {
+				if (runLengthEncoded) {
+					if (!DecodeScanline(data + scanlineOffsets[y], data + scanlineOffsets[y + 1], width, r)) {
+						failed = true;
+						return;
+					}
+				}
+				else {
+					const uint8_t* pixel = data + position + (size_t)y * width * 4;
+					for (int x = 0; x < width; x++, pixel += 4) {
+						r[x] = pixel[0];
+						g[x] = pixel[1];
+						b[x] = pixel[2];
+						e[x] = pixel[3];
+					}
+				}
+				// The file stores the top row first.
+				RGBE::ToFloat(r, g, b, e, pixels.data() + (size_t)(height - 1 - y) * width * 3, width);
+			}
+		});
+		if (failed) {
+			std::cout << "ERROR: Radiance file has a corrupt scanline" << std::endl;
+			return false;
+		}
+		return true;
+	}
+private:
+	static bool HasSignature(const uint8_t* data, size_t size) {
+		return (size >= 10 && memcmp(data, "#?RADIANCE", 10) == 0) || (size >= 6 && memcmp(data, "#?RGBE", 6) == 0);
+	}
+	// Header lines up to the blank line, then the resolution line. Only the usual "-Y height +X width"
+	// orientation is supported, like stb_image.
+	static bool ReadHeader(const uint8_t* data, size_t size, size_t& position, int& width, int& height) {
+		if (!HasSignature(data, size)) {
+			std::cout << "ERROR: Not a Radiance file" << std::endl;
+			return false;
+		}
+		bool rgbe = false;
+		while (true) {
+			std::string line;
+			if (!ReadLine(data, size, position, line)) {
+				std::cout << "ERROR: Radiance header has no end" << std::endl;
+				return false;
+			}
+			if (line.empty()) break;
+			if (line == "FORMAT=32-bit_rle_rgbe") rgbe = true;
+		}
+		if (!rgbe) {
+			std::cout << "ERROR: Radiance file is not in 32-bit_rle_rgbe format" << std::endl;
+			return false;
+		}
+		std::string resolution, axisY, axisX;
+		ReadLine(data, size, position, resolution);
+		std::istringstream stream = std::istringstream(resolution);
+		height = width = 0;
+		stream >> axisY >> height >> axisX >> width;
+		if (axisY != "-Y" || axisX != "+X" || width <= 0 || height <= 0) {
+			std::cout << "ERROR: Unsupported Radiance resolution line <" << resolution << ">" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	static bool ReadLine(const uint8_t* data, size_t size, size_t& position, std::string& line) {
+		const uint8_t* end = (const uint8_t*)memchr(data + position, '\n', size - position);
+		if (!end) return false;
+		line.assign((const char*)data + position, (const char*)end);
+		position = end - data + 1;
+		return true;
+	}
+	// RLE files start every scanline with 2, 2 and the width; anything else is read as flat RGBE.
+	static bool IsRunLengthEncoded(const uint8_t* data, size_t size, int width) {
+		if (width < 8 || width > 0x7FFF || size < 4) return false;
+		return data[0] == 2 && data[1] == 2 && !(data[2] & 0x80);
+	}
+	// Walks the run lengths without decoding them, to find where each scanline starts. The offsets
+	// end with one past the last scanline.
+	static bool IndexScanlines(const uint8_t* data, size_t size, size_t position, int width, int height, std::vector<size_t>& scanlineOffsets) {
+		scanlineOffsets.resize(height + 1);
+		for (int y = 0; y < height; y++) {
+			scanlineOffsets[y] = position;
+			if (size - position < 4 || data[position] != 2 || data[position + 1] != 2 || ((data[position + 2] << 8) | data[position + 3]) != width) {
+				std::cout << "ERROR: Radiance scanline " << y << " has a bad header" << std::endl;
+				return false;
+			}
+			position += 4;
+			for (int channel = 0; channel < 4; channel++) {
+				int x = 0;
+				while (x < width) {
+					if (position >= size) {
+						std::cout << "ERROR: Radiance file is truncated" << std::endl;
+						return false;
+					}
+					int count = data[position++];
+					if (count > 128) {
+						count -= 128;
+						position++;
+					}
+					else position += count;
+					if (count == 0 || x + count > width) {
+						std::cout << "ERROR: Radiance scanline " << y << " has a bad run" << std::endl;
+						return false;
+					}
+					x += count;
+				}
+			}
+			if (position > size) {
+				std::cout << "ERROR: Radiance file is truncated" << std::endl;
+				return false;
+			}
+		}
+		scanlineOffsets[height] = position;
+		return true;
+	}
+	// One RLE scanline from [data, end), already validated by IndexScanlines(), into four planes of width bytes.
+	static bool DecodeScanline(const uint8_t* data, const uint8_t* end, int width, uint8_t* planes) {
+		data += 4;
+		for (int channel = 0; channel < 4; channel++) {
+			uint8_t* plane = planes + (size_t)channel * width;
+			int x = 0;
+			while (x < width && data < end) {
+				int count = *data++;
+				if (count > 128) {
+					count -= 128;
+					memset(plane + x, *data++, count);
+				}
+				else {
+					memcpy(plane + x, data, count);
+					data += count;
+				}
+				x += count;
+			}
+			if (x != width) return false;
+		}
+		return true;
+	}
+};
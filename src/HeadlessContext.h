@@ -0,0 +1,73 @@
+#pragma once
+#include <iostream>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#if defined(__linux__)
+#define CLERESTORY_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// OpenGL context without a visible window. On Linux this is a surfaceless EGL context, which
+// also works on Mesa llvmpipe without a display server. Elsewhere it falls back to a hidden
+// GLFW window. Rendering must go to offscreen targets either way.
+class HeadlessContext {
+public:
+	HeadlessContext() {
+#ifdef CLERESTORY_EGL
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (eglGetPlatformDisplayEXT) display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API)) Fail("Failed to initialize EGL");
+
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, 5,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+
+		if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) Fail("Failed to create surfaceless EGL context");
+
+		if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) Fail("Failed to initialize GLAD");
+#else
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		window = glfwCreateWindow(1, 1, "Clerestory", NULL, NULL);
+		if (!window) Fail("Failed to create hidden GLFW window");
+		glfwMakeContextCurrent(window);
+
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) Fail("Failed to initialize GLAD");
+#endif
+		std::cout << "Headless context: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+	}
+	~HeadlessContext() {
+#ifdef CLERESTORY_EGL
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+#else
+		glfwDestroyWindow(window);
+		glfwTerminate();
+#endif
+	}
+private:
+#ifdef CLERESTORY_EGL
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+#else
+	GLFWwindow* window = NULL;
+#endif
+private:
+	void Fail(const char* message) {
+		std::cout << "ERROR: " << message << std::endl;
+		exit(-1);
+	}
+};
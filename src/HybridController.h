@@ -0,0 +1,51 @@
+#pragma once
+#include <algorithm>
+
+// Splits every hybrid frame between the GPU and the CPU. The image is a queue of tile rows: the GPU
+// takes rows from the bottom, the CPU threads from the top, and the controller decides where the
+// two meet. After each frame the measured rows per second of both devices give the split at which
+// they would have finished together, and the current split moves part of the way there so a single
+// noisy frame cannot make it oscillate.
+class HybridController {
+public:
+	// Share of the rows the GPU starts with, before anything has been measured.
+	HybridController(float gpuFraction = 0.5f) {
+		this->gpuFraction = gpuFraction;
+	}
+	// Rows [0, split) go to the GPU and [split, height) to the CPU. The split lies on a multiple of
+	// granularity, and both sides keep at least one step so their throughput stays measurable.
+	unsigned int GetSplitRow(unsigned int height, unsigned int granularity) {
+		unsigned int steps = (height + granularity - 1) / granularity;
+		if (steps < 2) return height;
+
+		unsigned int gpuSteps = (unsigned int)(gpuFraction * steps + 0.5f);
+		gpuSteps = std::min(std::max(gpuSteps, 1u), steps - 1);
+		return gpuSteps * granularity;
+	}
+	void Update(unsigned int gpuRows, double gpuSeconds, unsigned int cpuRows, double cpuSeconds) {
+		if (gpuRows == 0 || cpuRows == 0 || gpuSeconds <= 0.0 || cpuSeconds <= 0.0) return;
+
+		double gpuRate = gpuRows / gpuSeconds;
+		double cpuRate = cpuRows / cpuSeconds;
+		float balanced = (float)(gpuRate / (gpuRate + cpuRate));
+
+		gpuFraction += GAIN * (balanced - gpuFraction);
+		this->gpuSeconds = gpuSeconds;
+		this->cpuSeconds = cpuSeconds;
+	}
+	float GetGpuFraction() {
+		return gpuFraction;
+	}
+	// Device times of the last measured frame.
+	double GetGpuSeconds() {
+		return gpuSeconds;
+	}
+	double GetCpuSeconds() {
+		return cpuSeconds;
+	}
+private:
+	const float GAIN = 0.5f;
+
+	float gpuFraction;
+	double gpuSeconds = 0.0, cpuSeconds = 0.0;
+};
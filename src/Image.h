@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+
+// Linear RGB float image, rows stored bottom to top as OpenGL reads them back.
+struct Image {
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<float> pixels;
+
+	Image() {}
+	Image(unsigned int width, unsigned int height) {
+		this->width = width;
+		this->height = height;
+		pixels.resize((size_t)width * height * 3, 0.0f);
+	}
+	float* Pixel(unsigned int x, unsigned int y) {
+		return &pixels[((size_t)y * width + x) * 3];
+	}
+	const float* Pixel(unsigned int x, unsigned int y) const {
+		return &pixels[((size_t)y * width + x) * 3];
+	}
+};
+
+// Pixels laid out like an Image but owned elsewhere, such as a mapped readback buffer.
+struct ImageView {
+	unsigned int width = 0;
+	unsigned int height = 0;
+	const float* pixels = nullptr;
+
+	ImageView(const Image& image) {
+		width = image.width;
+		height = image.height;
+		pixels = image.pixels.data();
+	}
+	ImageView(unsigned int width, unsigned int height, const float* pixels) {
+		this->width = width;
+		this->height = height;
+		this->pixels = pixels;
+	}
+	const float* Pixel(unsigned int x, unsigned int y) const {
+		return &pixels[((size_t)y * width + x) * 3];
+	}
+};
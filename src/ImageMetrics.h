@@ -0,0 +1,188 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "Image.h"
+#include "ImageWriter.h"
+
+// Error of a rendered image against a reference of the same size, both linear RGB.
+class ImageMetrics {
+public:
+	// Viewing distance used by FLIP by default: a 0.7 m wide 4K monitor seen from 0.7 m.
+	static constexpr float DEFAULT_PIXELS_PER_DEGREE = 67.0f;
+public:
+	static double MSE(const ImageView& image, const ImageView& reference) {
+		double sum = 0.0;
+		size_t count = (size_t)image.width * image.height * 3;
+		for (size_t i = 0; i < count; i++) {
+			double difference = (double)image.pixels[i] - reference.pixels[i];
+			sum += difference * difference;
+		}
+		return count ? sum / count : 0.0;
+	}
+	static double RMSE(const ImageView& image, const ImageView& reference) {
+		return std::sqrt(MSE(image, reference));
+	}
+	// Squared error relative to the reference value, so dark and bright regions weigh alike; epsilon keeps black from dividing by zero.
+	static double RelMSE(const ImageView& image, const ImageView& reference, double epsilon = 0.01) {
+		double sum = 0.0;
+		size_t count = (size_t)image.width * image.height * 3;
+		for (size_t i = 0; i < count; i++) {
+			double difference = (double)image.pixels[i] - reference.pixels[i];
+			sum += difference * difference / ((double)reference.pixels[i] * reference.pixels[i] + epsilon);
+		}
+		return count ? sum / count : 0.0;
+	}
+	// Per pixel perceived difference in [0, 1] after the tonemapping the renderer presents with. This is
+	// the colour pipeline of NVIDIA's FLIP: both images are blurred in a linearized opponent space by
+	// the contrast sensitivity at the given viewing distance, compared as Hunt-adjusted HyAB distance in
+	// L*a*b* and compressed the same way. FLIP's edge and point feature term is left out, and each
+	// channel's sensitivity is a single Gaussian, so the values are close to FLIP but not identical.
+	static std::vector<float> FLIPErrorMap(const ImageView& image, const ImageView& reference, float pixelsPerDegree = DEFAULT_PIXELS_PER_DEGREE) {
+		std::vector<glm::vec3> test = Filter(ToOpponent(image), image.width, image.height, pixelsPerDegree);
+		std::vector<glm::vec3> target = Filter(ToOpponent(reference), image.width, image.height, pixelsPerDegree);
+
+		const float qc = 0.7f, pc = 0.4f, pt = 0.95f;
+		float cmax = std::pow(HyAB(HuntLab(glm::vec3(0.0f, 1.0f, 0.0f)), HuntLab(glm::vec3(0.0f, 0.0f, 1.0f))), qc);
+
+		std::vector<float> errors(test.size());
+		for (size_t i = 0; i < test.size(); i++) {
+			float error = std::pow(HyAB(HuntLab(OpponentToRGB(test[i])), HuntLab(OpponentToRGB(target[i]))), qc);
+			// Linear up to pc of the largest difference, where it reaches pt, then compressed up to 1.
+			errors[i] = error < pc * cmax ? pt / (pc * cmax) * error : std::min(1.0f, pt + (error - pc * cmax) / (cmax - pc * cmax) * (1.0f - pt));
+		}
+		return errors;
+	}
+	static double MeanFLIP(const ImageView& image, const ImageView& reference, float pixelsPerDegree = DEFAULT_PIXELS_PER_DEGREE) {
+		std::vector<float> errors = FLIPErrorMap(image, reference, pixelsPerDegree);
+		double sum = 0.0;
+		for (float error : errors) sum += error;
+		return errors.empty() ? 0.0 : sum / errors.size();
+	}
+	// Per pixel error in units of the tolerance |image - reference| <= absolute + relative * |reference|,
+	// the largest over the channels: a pixel is within tolerance when its value is at most 1.
+	static std::vector<float> ToleranceMap(const ImageView& image, const ImageView& reference, float absolute, float relative) {
+		std::vector<float> errors((size_t)image.width * image.height);
+		for (size_t i = 0; i < errors.size(); i++) {
+			float error = 0.0f;
+			for (int c = 0; c < 3; c++) {
+				float value = image.pixels[i * 3 + c], target = reference.pixels[i * 3 + c];
+				float tolerance = absolute + relative * std::abs(target);
+				float difference = std::abs(value - target);
+				float ratio = tolerance > 0.0f ? difference / tolerance : (difference > 0.0f ? 2.0f : 0.0f);
+				// A NaN would drop out of std::max() and pass; count it as out of tolerance instead.
+				if (ratio != ratio) ratio = 2.0f;
+				error = std::max(error, ratio);
+			}
+			errors[i] = error;
+		}
+		return errors;
+	}
+	// False colour for per pixel values laid out like an Image: black at 0 through blue, green and
+	// yellow to white at 1, and magenta above 1. 8 bit RGB top row first, for ImageWriter::WritePNG().
+	static std::vector<unsigned char> Heatmap(const std::vector<float>& values, unsigned int width, unsigned int height) {
+		const glm::vec3 stops[] = { glm::vec3(0.0f), glm::vec3(0.1f, 0.2f, 1.0f), glm::vec3(0.0f, 0.8f, 0.3f), glm::vec3(1.0f, 0.9f, 0.0f), glm::vec3(1.0f) };
+		const int lastStop = 4;
+
+		std::vector<unsigned char> rgb((size_t)width * height * 3);
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				float value = values[(size_t)(height - 1 - y) * width + x];
+				glm::vec3 color = glm::vec3(1.0f, 0.0f, 1.0f);
+				if (value <= 1.0f) {
+					float position = std::max(value, 0.0f) * lastStop;
+					int stop = std::min((int)position, lastStop - 1);
+					color = glm::mix(stops[stop], stops[stop + 1], position - stop);
+				}
+				for (int c = 0; c < 3; c++) rgb[((size_t)y * width + x) * 3 + c] = (unsigned char)(color[c] * 255.0f + 0.5f);
+			}
+		}
+		return rgb;
+	}
+private:
+	// D65 white in XYZ.
+	static glm::vec3 White() {
+		return glm::vec3(0.950456f, 1.0f, 1.088754f);
+	}
+	static glm::vec3 RGBToXYZ(glm::vec3 rgb) {
+		return glm::vec3(
+			0.4124564f * rgb.r + 0.3575761f * rgb.g + 0.1804375f * rgb.b,
+			0.2126729f * rgb.r + 0.7151522f * rgb.g + 0.0721750f * rgb.b,
+			0.0193339f * rgb.r + 0.1191920f * rgb.g + 0.9503041f * rgb.b);
+	}
+	static glm::vec3 XYZToRGB(glm::vec3 xyz) {
+		return glm::vec3(
+			3.2404542f * xyz.x - 1.5371385f * xyz.y - 0.4985314f * xyz.z,
+			-0.9692660f * xyz.x + 1.8760108f * xyz.y + 0.0415560f * xyz.z,
+			0.0556434f * xyz.x - 0.2040259f * xyz.y + 1.0572252f * xyz.z);
+	}
+	// Tonemapped like the presented image, then YCxCz: L*a*b* without the cube root, so blurring it is linear in light.
+	static std::vector<glm::vec3> ToOpponent(const ImageView& image) {
+		std::vector<glm::vec3> opponent((size_t)image.width * image.height);
+		for (size_t i = 0; i < opponent.size(); i++) {
+			const float* pixel = image.pixels + i * 3;
+			glm::vec3 rgb = glm::vec3(ImageWriter::ACESFilm(pixel[0]), ImageWriter::ACESFilm(pixel[1]), ImageWriter::ACESFilm(pixel[2]));
+			glm::vec3 xyz = RGBToXYZ(rgb) / White();
+			opponent[i] = glm::vec3(116.0f * xyz.y - 16.0f, 500.0f * (xyz.x - xyz.y), 200.0f * (xyz.y - xyz.z));
+		}
+		return opponent;
+	}
+	static glm::vec3 OpponentToRGB(glm::vec3 opponent) {
+		float y = (opponent.x + 16.0f) / 116.0f;
+		glm::vec3 xyz = glm::vec3(opponent.y / 500.0f + y, y, y - opponent.z / 200.0f) * White();
+		return glm::clamp(XYZToRGB(xyz), 0.0f, 1.0f);
+	}
+	// L*a*b* with a and b scaled by lightness, as FLIP does to model the Hunt effect.
+	static glm::vec3 HuntLab(glm::vec3 rgb) {
+		glm::vec3 xyz = RGBToXYZ(rgb) / White();
+		auto f = [](float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f; };
+		float fx = f(xyz.x), fy = f(xyz.y), fz = f(xyz.z);
+		float lightness = 116.0f * fy - 16.0f;
+		return glm::vec3(lightness, 500.0f * (fx - fy) * 0.01f * lightness, 200.0f * (fy - fz) * 0.01f * lightness);
+	}
+	static float HyAB(glm::vec3 a, glm::vec3 b) {
+		glm::vec2 chroma = glm::vec2(a.y - b.y, a.z - b.z);
+		return std::abs(a.x - b.x) + glm::length(chroma);
+	}
+	// Separable Gaussian per channel. FLIP's contrast sensitivity exp(-pi^2 x^2 / b) has a standard
+	// deviation of sqrt(b / (2 pi^2)) degrees; b is 0.0047 for lightness, 0.0053 for red-green and
+	// 0.04 for the dominant term of blue-yellow. Edges are clamped.
+	static std::vector<glm::vec3> Filter(const std::vector<glm::vec3>& pixels, unsigned int width, unsigned int height, float pixelsPerDegree) {
+		const float PI = 3.14159265359f;
+		glm::vec3 sigma = glm::sqrt(glm::vec3(0.0047f, 0.0053f, 0.04f) / (2.0f * PI * PI)) * pixelsPerDegree;
+		int radius = (int)std::ceil(3.0f * std::max(sigma.x, std::max(sigma.y, sigma.z)));
+
+		std::vector<glm::vec3> weights(radius * 2 + 1);
+		glm::vec3 weightSum = glm::vec3(0.0f);
+		for (int i = -radius; i <= radius; i++) {
+			weights[i + radius] = glm::exp(-(float)(i * i) / (2.0f * sigma * sigma));
+			weightSum += weights[i + radius];
+		}
+		for (glm::vec3& weight : weights) weight /= weightSum;
+
+		std::vector<glm::vec3> horizontal(pixels.size()), filtered(pixels.size());
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				glm::vec3 sum = glm::vec3(0.0f);
+				for (int i = -radius; i <= radius; i++) {
+					int sx = std::min(std::max((int)x + i, 0), (int)width - 1);
+					sum += weights[i + radius] * pixels[(size_t)y * width + sx];
+				}
+				horizontal[(size_t)y * width + x] = sum;
+			}
+		}
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				glm::vec3 sum = glm::vec3(0.0f);
+				for (int i = -radius; i <= radius; i++) {
+					int sy = std::min(std::max((int)y + i, 0), (int)height - 1);
+					sum += weights[i + radius] * horizontal[(size_t)sy * width + x];
+				}
+				filtered[(size_t)y * width + x] = sum;
+			}
+		}
+		return filtered;
+	}
+};
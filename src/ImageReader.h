@@ -0,0 +1,45 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+#include "Image.h"
+
+// Reads back the lossless images ImageWriter produces, for references and golden images.
+class ImageReader {
+public:
+	// Colour PFM ("PF") of either byte order. PFM rows run bottom to top like an Image.
+	static bool ReadPFM(const std::string& path, Image& image) {
+		std::ifstream file = std::ifstream(path, std::ios::binary);
+		if (!file.is_open()) return false;
+
+		std::string magic;
+		unsigned int width = 0, height = 0;
+		float scale = 0.0f;
+		file >> magic >> width >> height >> scale;
+		// Exactly one whitespace character separates the header from the pixels.
+		file.get();
+		if (!file || magic != "PF" || width == 0 || height == 0 || scale == 0.0f) {
+			std::cout << "ERROR: <" << path << "> is not a colour PFM" << std::endl;
+			return false;
+		}
+		image = Image(width, height);
+		file.read((char*)image.pixels.data(), image.pixels.size() * sizeof(float));
+		if (!file) {
+			std::cout << "ERROR: PFM <" << path << "> is truncated" << std::endl;
+			return false;
+		}
+		// A positive scale marks big endian.
+		if (scale > 0.0f) {
+			for (float& value : image.pixels) {
+				uint32_t bits;
+				memcpy(&bits, &value, 4);
+				bits = (bits >> 24) | ((bits >> 8) & 0xFF00u) | ((bits << 8) & 0xFF0000u) | (bits << 24);
+				memcpy(&value, &bits, 4);
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,383 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "Image.h"
+
+enum class ImageFormat {
+	pfm,
+	exr,
+	png
+};
+
+// Writers for linear (PFM, EXR) and tonemapped (PNG) output. No third party codecs: EXR is
+// written uncompressed and PNG uses stored deflate blocks.
+//
+// Every file is a header, one block per range of file scanlines and a trailer. Blocks share no
+// state, so a large image can encode its blocks on as many threads as there are blocks.
+class ImageWriter {
+	friend class TiledEXRWriter;
+public:
+	struct EncodedBlock {
+		std::vector<char> bytes;
+		// PNG only: Adler-32 and length of the raw scanlines, which the trailer needs for the whole image.
+		uint32_t adler = 1;
+		size_t rawSize = 0;
+	};
+public:
+	static bool WritePFM(const std::string& path, const ImageView& image) {
+		return Write(path, ImageFormat::pfm, image);
+	}
+	static bool WriteEXR(const std::string& path, const ImageView& image) {
+		return Write(path, ImageFormat::exr, image);
+	}
+	// ACES filmic tonemap and sRGB encoding, matching PostProcess.frag on an sRGB framebuffer.
+	static bool WritePNG(const std::string& path, const ImageView& image) {
+		return Write(path, ImageFormat::png, image);
+	}
+	// Already display referred 8 bit RGB, top row first, such as a false colour visualization.
+	static bool WritePNG(const std::string& path, unsigned int width, unsigned int height, const std::vector<unsigned char>& rgb) {
+		std::vector<unsigned char> scanlines;
+		scanlines.reserve((size_t)height * (width * 3 + 1));
+		for (unsigned int y = 0; y < height; y++) {
+			scanlines.push_back(0);
+			scanlines.insert(scanlines.end(), rgb.begin() + (size_t)y * width * 3, rgb.begin() + (size_t)(y + 1) * width * 3);
+		}
+		std::vector<EncodedBlock> blocks = { EncodePNGScanlines(scanlines) };
+		return WriteEncoded(path, EncodeHeader(ImageFormat::png, width, height), blocks, EncodeTrailer(ImageFormat::png, blocks));
+	}
+	static bool Write(const std::string& path, ImageFormat format, const ImageView& image) {
+		std::vector<EncodedBlock> blocks = { EncodeBlock(format, image, 0, image.height) };
+		return WriteEncoded(path, EncodeHeader(format, image.width, image.height), blocks, EncodeTrailer(format, blocks));
+	}
+	static bool WriteEncoded(const std::string& path, const std::vector<char>& header, const std::vector<EncodedBlock>& blocks, const std::vector<char>& trailer) {
+		std::ofstream file = std::ofstream(path, std::ios::binary);
+		if (!file.is_open()) return WriteError(path);
+
+		file.write(header.data(), header.size());
+		for (const EncodedBlock& block : blocks) file.write(block.bytes.data(), block.bytes.size());
+		file.write(trailer.data(), trailer.size());
+
+		return file.good() || WriteError(path);
+	}
+	static std::vector<char> EncodeHeader(ImageFormat format, unsigned int width, unsigned int height) {
+		std::vector<char> header;
+		if (format == ImageFormat::pfm) {
+			// A negative scale marks little endian.
+			std::string text = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+			header.assign(text.begin(), text.end());
+		}
+		else if (format == ImageFormat::exr) {
+			header = BuildEXRHeader(width, height);
+			// Uncompressed scanlines all have the same size, so the offset table is known up front.
+			uint64_t tableEnd = header.size() + (uint64_t)height * 8;
+			for (uint64_t y = 0; y < height; y++) {
+				uint64_t offset = tableEnd + y * GetEXRScanlineBytes(width);
+				header.insert(header.end(), (const char*)&offset, (const char*)&offset + 8);
+			}
+		}
+		else {
+			const char signature[8] = { (char)0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			header.assign(signature, signature + 8);
+
+			std::vector<unsigned char> ihdr;
+			PushBigEndian(ihdr, width);
+			PushBigEndian(ihdr, height);
+			ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 });
+			PushPNGChunk(header, "IHDR", ihdr);
+			// The zlib stream is split over one IDAT per block; this one only opens it.
+			PushPNGChunk(header, "IDAT", { 0x78, 0x01 });
+		}
+		return header;
+	}
+	// File scanlines [begin, end). Files run top to bottom except PFM, which runs bottom to top like the image.
+	static EncodedBlock EncodeBlock(ImageFormat format, const ImageView& image, unsigned int begin, unsigned int end) {
+		EncodedBlock block;
+		if (format == ImageFormat::pfm) {
+			const char* rows = (const char*)image.Pixel(0, begin);
+			block.bytes.assign(rows, rows + (size_t)(end - begin) * image.width * 3 * sizeof(float));
+		}
+		else if (format == ImageFormat::exr) {
+			// Each scanline: y, byte count, then the B, G and R planes.
+			block.bytes.resize((size_t)(end - begin) * GetEXRScanlineBytes(image.width));
+			char* out = block.bytes.data();
+			for (unsigned int y = begin; y < end; y++) {
+				const float* row = image.Pixel(0, image.height - 1 - y);
+				int32_t lineY = (int32_t)y;
+				int32_t dataSize = (int32_t)(image.width * 3 * sizeof(float));
+				memcpy(out, &lineY, 4);
+				memcpy(out + 4, &dataSize, 4);
+				float* planes = (float*)(out + 8);
+				for (unsigned int x = 0; x < image.width; x++) {
+					planes[x] = row[x * 3 + 2];
+					planes[image.width + x] = row[x * 3 + 1];
+					planes[image.width * 2 + x] = row[x * 3 + 0];
+				}
+				out += GetEXRScanlineBytes(image.width);
+			}
+		}
+		else {
+			std::vector<unsigned char> scanlines;
+			scanlines.reserve((size_t)(end - begin) * (image.width * 3 + 1));
+			for (unsigned int y = begin; y < end; y++) {
+				const float* row = image.Pixel(0, image.height - 1 - y);
+				scanlines.push_back(0);
+				for (unsigned int i = 0; i < image.width * 3; i++) scanlines.push_back(EncodeSRGB(ACESFilm(row[i])));
+			}
+			block = EncodePNGScanlines(scanlines);
+		}
+		return block;
+	}
+	// blocks must cover every scanline, in file order.
+	static std::vector<char> EncodeTrailer(ImageFormat format, const std::vector<EncodedBlock>& blocks) {
+		std::vector<char> trailer;
+		if (format != ImageFormat::png) return trailer;
+
+		uint32_t adler = 1;
+		for (const EncodedBlock& block : blocks) adler = CombineAdler32(adler, block.adler, block.rawSize);
+
+		// An empty final deflate block closes the stream, so no block has to know that it is the last.
+		std::vector<unsigned char> end = StoredDeflate(std::vector<unsigned char>(), true);
+		PushBigEndian(end, adler);
+		PushPNGChunk(trailer, "IDAT", end);
+		PushPNGChunk(trailer, "IEND", std::vector<unsigned char>());
+		return trailer;
+	}
+	static const char* GetExtension(ImageFormat format) {
+		switch (format) {
+		case ImageFormat::pfm: return "pfm";
+		case ImageFormat::exr: return "exr";
+		default: return "png";
+		}
+	}
+	static bool ParseFormat(const std::string& name, ImageFormat& format) {
+		for (ImageFormat candidate : { ImageFormat::pfm, ImageFormat::exr, ImageFormat::png }) {
+			if (name == GetExtension(candidate)) {
+				format = candidate;
+				return true;
+			}
+		}
+		return false;
+	}
+	static float ACESFilm(float x) {
+		const float a = 2.51f, b = 0.03f, c = 2.43f, d = 0.59f, e = 0.14f;
+		return glm::clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0f, 1.0f);
+	}
+	static unsigned char EncodeSRGB(float linear) {
+		float srgb = linear <= 0.0031308f ? linear * 12.92f : 1.055f * glm::pow(linear, 1.0f / 2.4f) - 0.055f;
+		return (unsigned char)glm::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f);
+	}
+private:
+	static bool WriteError(const std::string& path) {
+		std::cout << "ERROR: Could not write image at path <" << path << ">" << std::endl;
+		return false;
+	}
+	static uint64_t GetEXRScanlineBytes(unsigned int width) {
+		return 8 + (uint64_t)width * 3 * sizeof(float);
+	}
+	static void PushBigEndian(std::vector<unsigned char>& bytes, uint32_t value) {
+		bytes.insert(bytes.end(), { (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value });
+	}
+	static void PushAttribute(std::vector<char>& header, const char* name, const char* type, const void* value, int32_t size) {
+		header.insert(header.end(), name, name + strlen(name) + 1);
+		header.insert(header.end(), type, type + strlen(type) + 1);
+		header.insert(header.end(), (const char*)&size, (const char*)&size + 4);
+		header.insert(header.end(), (const char*)value, (const char*)value + size);
+	}
+	// A non zero tile size describes a single level tiled file instead of scanlines.
+	static std::vector<char> BuildEXRHeader(unsigned int width, unsigned int height, unsigned int tileSize = 0) {
+		// Version 2, bit 9 of the flags marks a tiled file.
+		std::vector<char> header = { 0x76, 0x2f, 0x31, 0x01, 2, (char)(tileSize ? 0x02 : 0), 0, 0 };
+
+		std::vector<char> channels;
+		for (const char* name : { "B", "G", "R" }) {
+			const int32_t pixelType = 2, sampling = 1;
+			channels.push_back(name[0]);
+			channels.push_back(0);
+			channels.insert(channels.end(), (const char*)&pixelType, (const char*)&pixelType + 4);
+			channels.insert(channels.end(), 4, 0);
+			channels.insert(channels.end(), (const char*)&sampling, (const char*)&sampling + 4);
+			channels.insert(channels.end(), (const char*)&sampling, (const char*)&sampling + 4);
+		}
+		channels.push_back(0);
+		PushAttribute(header, "channels", "chlist", channels.data(), (int32_t)channels.size());
+
+		const char compression = 0, lineOrder = 0;
+		const int32_t window[4] = { 0, 0, (int32_t)width - 1, (int32_t)height - 1 };
+		const float pixelAspectRatio = 1.0f, screenWindowCenter[2] = { 0.0f, 0.0f }, screenWindowWidth = 1.0f;
+		PushAttribute(header, "compression", "compression", &compression, 1);
+		PushAttribute(header, "dataWindow", "box2i", window, 16);
+		PushAttribute(header, "displayWindow", "box2i", window, 16);
+		PushAttribute(header, "lineOrder", "lineOrder", &lineOrder, 1);
+		PushAttribute(header, "pixelAspectRatio", "float", &pixelAspectRatio, 4);
+		PushAttribute(header, "screenWindowCenter", "v2f", screenWindowCenter, 8);
+		PushAttribute(header, "screenWindowWidth", "float", &screenWindowWidth, 4);
+		if (tileSize) {
+			// tiledesc: tile width, tile height and one level with rounding down.
+			char tiles[9] = {};
+			memcpy(tiles, &tileSize, 4);
+			memcpy(tiles + 4, &tileSize, 4);
+			PushAttribute(header, "tiles", "tiledesc", tiles, 9);
+		}
+		header.push_back(0);
+
+		return header;
+	}
+	static uint32_t CRC32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+		// Built on first use; blocks may be encoded on several threads at once.
+		static const std::array<uint32_t, 256> table = []() {
+			std::array<uint32_t, 256> entries;
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[i] = c;
+			}
+			return entries;
+		}();
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+	static uint32_t Adler32(const unsigned char* data, size_t size) {
+		uint32_t a = 1, b = 0;
+		while (size > 0) {
+			size_t block = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < block; i++) {
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += block;
+			size -= block;
+		}
+		return (b << 16) | a;
+	}
+	// Adler-32 of two concatenated ranges from the checksums of each, as zlib's adler32_combine().
+	static uint32_t CombineAdler32(uint32_t adler1, uint32_t adler2, size_t size2) {
+		const uint64_t base = 65521;
+		uint64_t remainder = size2 % base;
+		uint64_t a = ((adler1 & 0xFFFF) + (adler2 & 0xFFFF) + base - 1) % base;
+		uint64_t b = (remainder * (adler1 & 0xFFFF) + (adler1 >> 16) + (adler2 >> 16) + base - remainder) % base;
+		return (uint32_t)((b << 16) | a);
+	}
+	// Stored deflate blocks of at most 64KiB. final marks the last block of the stream.
+	static std::vector<unsigned char> StoredDeflate(const std::vector<unsigned char>& data, bool final) {
+		std::vector<unsigned char> deflate;
+		deflate.reserve(data.size() + (data.size() / 65535 + 1) * 5);
+		size_t offset = 0;
+		do {
+			size_t blockSize = std::min<size_t>(data.size() - offset, 65535);
+			bool last = final && offset + blockSize == data.size();
+			deflate.push_back(last ? 1 : 0);
+			deflate.insert(deflate.end(), { (unsigned char)blockSize, (unsigned char)(blockSize >> 8), (unsigned char)~blockSize, (unsigned char)(~blockSize >> 8) });
+			deflate.insert(deflate.end(), data.begin() + offset, data.begin() + offset + blockSize);
+			offset += blockSize;
+		} while (offset < data.size());
+		return deflate;
+	}
+	// Filter byte prefixed scanlines as one IDAT of the image's zlib stream.
+	static EncodedBlock EncodePNGScanlines(const std::vector<unsigned char>& scanlines) {
+		EncodedBlock block;
+		block.adler = Adler32(scanlines.data(), scanlines.size());
+		block.rawSize = scanlines.size();
+		PushPNGChunk(block.bytes, "IDAT", StoredDeflate(scanlines, false));
+		return block;
+	}
+	static void PushPNGChunk(std::vector<char>& bytes, const char* type, const std::vector<unsigned char>& data) {
+		std::vector<unsigned char> chunk;
+		chunk.reserve(data.size() + 12);
+		PushBigEndian(chunk, (uint32_t)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		PushBigEndian(chunk, CRC32(chunk.data() + 4, chunk.size() - 4));
+		bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+	}
+};
+
+// Streams an uncompressed tiled EXR one tile at a time, so only the tile being written has to be in
+// memory. Tiles may arrive in any order; their place in the file is known up front because
+// uncompressed tiles have a fixed size.
+class TiledEXRWriter {
+public:
+	bool Open(const std::string& path, unsigned int width, unsigned int height, unsigned int tileSize) {
+		this->path = path;
+		this->width = width;
+		this->height = height;
+		this->tileSize = tileSize;
+
+		file.open(path, std::ios::binary);
+		if (!file.is_open()) return ImageWriter::WriteError(path);
+
+		std::vector<char> header = ImageWriter::BuildEXRHeader(width, height, tileSize);
+		file.write(header.data(), header.size());
+
+		// Offset table in tile order, row of tiles by row of tiles from the top.
+		uint64_t offset = header.size() + (uint64_t)GetTileCountX() * GetTileCountY() * 8;
+		for (unsigned int tileY = 0; tileY < GetTileCountY(); tileY++) {
+			for (unsigned int tileX = 0; tileX < GetTileCountX(); tileX++) {
+				tileOffsets.push_back(offset);
+				file.write((const char*)&offset, 8);
+				offset += 20 + (uint64_t)GetTileWidth(tileX) * GetTileHeight(tileY) * 3 * sizeof(float);
+			}
+		}
+		return file.good() || ImageWriter::WriteError(path);
+	}
+	// tile must be GetTileWidth(tileX) x GetTileHeight(tileY), bottom row first like every Image.
+	bool WriteTile(unsigned int tileX, unsigned int tileY, const Image& tile) {
+		unsigned int tileWidth = GetTileWidth(tileX), tileHeight = GetTileHeight(tileY);
+		if (tile.width != tileWidth || tile.height != tileHeight) {
+			std::cout << "ERROR: Tile " << tileX << "," << tileY << " is " << tile.width << "x" << tile.height
+				<< ", expected " << tileWidth << "x" << tileHeight << std::endl;
+			return false;
+		}
+		file.seekp(tileOffsets[tileY * GetTileCountX() + tileX]);
+
+		const int32_t coordinates[4] = { (int32_t)tileX, (int32_t)tileY, 0, 0 };
+		const int32_t dataSize = (int32_t)((size_t)tileWidth * tileHeight * 3 * sizeof(float));
+		file.write((const char*)coordinates, 16);
+		file.write((const char*)&dataSize, 4);
+
+		// Each scanline of the tile holds the B, G and R planes in turn.
+		std::vector<float> planes = std::vector<float>((size_t)tileWidth * 3);
+		for (unsigned int y = 0; y < tileHeight; y++) {
+			const float* row = tile.Pixel(0, tileHeight - 1 - y);
+			for (unsigned int x = 0; x < tileWidth; x++) {
+				planes[x] = row[x * 3 + 2];
+				planes[tileWidth + x] = row[x * 3 + 1];
+				planes[tileWidth * 2 + x] = row[x * 3 + 0];
+			}
+			file.write((const char*)planes.data(), planes.size() * sizeof(float));
+		}
+		return file.good() || ImageWriter::WriteError(path);
+	}
+	bool Close() {
+		file.close();
+		return !file.fail() || ImageWriter::WriteError(path);
+	}
+	unsigned int GetTileCountX() {
+		return (width + tileSize - 1) / tileSize;
+	}
+	unsigned int GetTileCountY() {
+		return (height + tileSize - 1) / tileSize;
+	}
+	// Tiles on the right and bottom edges are cut to the image.
+	unsigned int GetTileWidth(unsigned int tileX) {
+		return std::min(tileSize, width - tileX * tileSize);
+	}
+	unsigned int GetTileHeight(unsigned int tileY) {
+		return std::min(tileSize, height - tileY * tileSize);
+	}
+private:
+	std::string path;
+	std::ofstream file;
+	unsigned int width = 0, height = 0, tileSize = 0;
+	std::vector<uint64_t> tileOffsets;
+};
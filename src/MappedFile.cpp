@@ -0,0 +1,62 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+	bool opened = false;
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER fileSize;
+	if (handle != INVALID_HANDLE_VALUE && GetFileSizeEx(handle, &fileSize)) {
+		file = handle;
+		size = (size_t)fileSize.QuadPart;
+		// Empty files cannot be mapped, but open fine.
+		if (size == 0) return true;
+		mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping) data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		opened = data != nullptr;
+	}
+	else if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+	descriptor = open(path.c_str(), O_RDONLY);
+	struct stat status;
+	if (descriptor >= 0 && fstat(descriptor, &status) == 0) {
+		size = (size_t)status.st_size;
+		if (size == 0) return true;
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (mapped != MAP_FAILED) data = (const uint8_t*)mapped;
+		opened = data != nullptr;
+	}
+#endif
+	if (!opened) {
+		std::cout << "ERROR: Could not map file <" << path << ">" << std::endl;
+		Close();
+	}
+	return opened;
+}
+void MappedFile::Close() {
+#if defined(_WIN32)
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle((HANDLE)mapping);
+	if (file) CloseHandle((HANDLE)file);
+	file = nullptr;
+	mapping = nullptr;
+#else
+	if (data) munmap((void*)data, size);
+	if (descriptor >= 0) close(descriptor);
+	descriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
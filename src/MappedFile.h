@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// A whole file mapped read-only into memory, so large assets are paged in by the OS as they are
+// read instead of being copied through a stream buffer first. The platform code lives in
+// MappedFile.cpp to keep <windows.h> away from the GL headers.
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() {
+		Close();
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Prints an error and returns false if the file cannot be opened or mapped.
+	bool Open(const std::string& path);
+	void Close();
+	const uint8_t* GetData() {
+		return data;
+	}
+	size_t GetSize() {
+		return size;
+	}
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#if defined(_WIN32)
+	// HANDLEs, which are pointers.
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int descriptor = -1;
+#endif
+};
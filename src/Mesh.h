@@ -3,18 +3,23 @@
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
+#include "GLObject.h"
+
 class Mesh {
 public:
 	Mesh(const std::vector<glm::vec3>& verts, const std::vector<unsigned int>& indices) {
 		indicesSize = indices.size();
 
-		glGenVertexArrays(1, &vao);
-		glGenBuffers(1, &vbo);
-		glGenBuffers(1, &ebo);
+		GLuint ids[2];
+		glGenVertexArrays(1, ids);
+		vao.Reset(ids[0]);
+		glGenBuffers(2, ids);
+		vbo.Reset(ids[0]);
+		ebo.Reset(ids[1]);
 
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBindVertexArray(vao.Get());
+		glBindBuffer(GL_ARRAY_BUFFER, vbo.Get());
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo.Get());
 
 		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * verts.size(), verts.data(), GL_STATIC_DRAW);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
@@ -27,14 +32,14 @@ public:
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	void Draw() {
-		glBindVertexArray(vao);
+		glBindVertexArray(vao.Get());
 		glDrawElements(GL_TRIANGLES, indicesSize, GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
 	}
 protected:
-	unsigned int vao;
-	unsigned int vbo;
-	unsigned int ebo;
+	VertexArrayObject vao;
+	BufferObject vbo;
+	BufferObject ebo;
 
 	unsigned int indicesSize;
 };
\ No newline at end of file
@@ -0,0 +1,393 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stb_image/stb_image.h>
+
+#include "CpuFeatures.h"
+#include "CpuRenderKernel.h"
+#include "Noise.h"
+#include "HDRReader.h"
+#include "GameObject.h"
+#include "ImageWriter.h"
+#include "TileScheduler.h"
+
+// One CPU kernel under test. A run processes itemCount items split into chunkCount chunks, which
+// are spread over the threads of the run.
+struct MicroBenchmarkCase {
+	std::string name;
+	// What an item is, for the throughput column.
+	std::string unit;
+	size_t itemCount = 0;
+	size_t chunkCount = 1;
+	std::function<void(size_t chunk)> run;
+	// False for kernels that only run on one thread in the renderer.
+	bool threaded = true;
+	// Printed with the result, such as the deviation from the scalar kernel.
+	std::string note;
+};
+struct MicroBenchmarkResult {
+	std::string name;
+	unsigned int threadCount = 1;
+	// Median over the runs, and the median absolute deviation from it.
+	double secondsPerItem = 0.0;
+	double deviation = 0.0;
+	std::string unit;
+
+	std::string GetKey() const {
+		return name + "/t" + std::to_string(threadCount);
+	}
+};
+
+// Times the building blocks of the renderer one at a time, so a regression in a hot helper shows up
+// on its own rather than as noise in a full render. Every case is repeated until a run takes at
+// least minRunSeconds, then timed over runCount such runs; the median and its median absolute
+// deviation are what get reported and compared, so a few runs disturbed by the OS do not move them.
+class MicroBenchmark {
+public:
+	// Points, rays and objects handed to one thread at a time.
+	static const size_t CHUNK_ITEMS = 4096;
+public:
+	MicroBenchmark(unsigned int runCount, double minRunSeconds) {
+		this->runCount = std::max(runCount, 1u);
+		this->minRunSeconds = minRunSeconds;
+	}
+	// ray-AABB, cnoise() and RGBE conversion for every supported instruction set, GameObject matrix
+	// updates, .hdr decoding of environmentMapPath, and scanline block encoding for every image format.
+	static std::vector<MicroBenchmarkCase> GetCases(size_t itemCount, const std::string& environmentMapPath) {
+		std::vector<MicroBenchmarkCase> cases;
+		AddHitVolumeCases(cases, itemCount);
+		AddNoiseCases(cases, itemCount);
+		AddRGBECases(cases, itemCount);
+		AddGameObjectCase(cases, itemCount);
+		AddHDRDecodeCase(cases, environmentMapPath);
+		for (ImageFormat format : { ImageFormat::pfm, ImageFormat::exr, ImageFormat::png }) AddEncodeCase(cases, format);
+		return cases;
+	}
+	// Cases whose name contains filter, each on one thread and, when threaded, on every count in threadCounts.
+	std::vector<MicroBenchmarkResult> Run(const std::vector<MicroBenchmarkCase>& cases, const std::string& filter, const std::vector<unsigned int>& threadCounts) {
+		std::vector<MicroBenchmarkResult> results;
+		for (const MicroBenchmarkCase& benchmarkCase : cases) {
+			if (benchmarkCase.name.find(filter) == std::string::npos) continue;
+
+			std::vector<unsigned int> counts = { 1 };
+			if (benchmarkCase.threaded) {
+				for (unsigned int count : threadCounts) if (std::find(counts.begin(), counts.end(), count) == counts.end()) counts.push_back(count);
+			}
+			for (unsigned int threadCount : counts) {
+				results.push_back(Run(benchmarkCase, threadCount));
+				Print(results.back(), benchmarkCase.note);
+			}
+		}
+		return results;
+	}
+	MicroBenchmarkResult Run(const MicroBenchmarkCase& benchmarkCase, unsigned int threadCount) {
+		TileScheduler scheduler(benchmarkCase.chunkCount, threadCount);
+		auto runOnce = [&]() { scheduler.Run(benchmarkCase.run); };
+
+		// Warm up caches and lazily built tables, then double the repetitions until a run is long enough to time.
+		runOnce();
+		unsigned int repetitionCount = 1;
+		while (Time(runOnce, repetitionCount) < minRunSeconds && repetitionCount < (1u << 20)) repetitionCount *= 2;
+
+		std::vector<double> samples;
+		for (unsigned int i = 0; i < runCount; i++) samples.push_back(Time(runOnce, repetitionCount) / repetitionCount / benchmarkCase.itemCount);
+
+		MicroBenchmarkResult result;
+		result.name = benchmarkCase.name;
+		result.threadCount = threadCount;
+		result.unit = benchmarkCase.unit;
+		result.secondsPerItem = Median(samples);
+		for (double& sample : samples) sample = std::abs(sample - result.secondsPerItem);
+		result.deviation = Median(samples);
+		return result;
+	}
+	// One "<name>/t<threads> <seconds per item> <deviation>" line per result.
+	static bool Save(const std::string& path, const std::vector<MicroBenchmarkResult>& results) {
+		std::ofstream file = std::ofstream(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write micro-benchmark results <" << path << ">" << std::endl;
+			return false;
+		}
+		file.precision(9);
+		for (const MicroBenchmarkResult& result : results) file << result.GetKey() << " " << result.secondsPerItem << " " << result.deviation << "\n";
+		return !file.fail();
+	}
+	static bool Load(const std::string& path, std::map<std::string, MicroBenchmarkResult>& results) {
+		std::ifstream file = std::ifstream(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not open micro-benchmark baseline <" << path << ">" << std::endl;
+			return false;
+		}
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream stream = std::istringstream(line);
+			std::string key;
+			MicroBenchmarkResult result;
+			if (stream >> key >> result.secondsPerItem >> result.deviation) results[key] = result;
+		}
+		return true;
+	}
+	// Prints every result against the baseline and returns false if any of them got slower by more
+	// than tolerance (a fraction) and by more than three deviations of either measurement.
+	static bool Compare(const std::vector<MicroBenchmarkResult>& results, const std::map<std::string, MicroBenchmarkResult>& baseline, double tolerance) {
+		bool passed = true;
+		std::cout << "Against baseline:" << std::endl;
+		for (const MicroBenchmarkResult& result : results) {
+			std::map<std::string, MicroBenchmarkResult>::const_iterator found = baseline.find(result.GetKey());
+			if (found == baseline.end() || found->second.secondsPerItem <= 0.0) {
+				std::cout << "  " << result.GetKey() << ": not in baseline" << std::endl;
+				continue;
+			}
+			const MicroBenchmarkResult& base = found->second;
+			double change = result.secondsPerItem / base.secondsPerItem - 1.0;
+			double noise = 3.0 * std::max(result.deviation, base.deviation) / base.secondsPerItem;
+			double threshold = std::max(tolerance, noise);
+
+			const char* verdict = "unchanged";
+			if (change > threshold) {
+				verdict = "REGRESSION";
+				passed = false;
+			}
+			else if (change < -threshold) verdict = "faster";
+			std::cout << "  " << result.GetKey() << ": " << (change >= 0.0 ? "+" : "") << change * 100.0 << "% time (threshold "
+				<< threshold * 100.0 << "%) " << verdict << std::endl;
+		}
+		return passed;
+	}
+	static double Median(std::vector<double> values) {
+		if (values.empty()) return 0.0;
+		std::sort(values.begin(), values.end());
+		size_t middle = values.size() / 2;
+		return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+	}
+private:
+	unsigned int runCount;
+	double minRunSeconds;
+private:
+	static double Time(const std::function<void()>& runOnce, unsigned int repetitionCount) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < repetitionCount; i++) runOnce();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	static void Print(const MicroBenchmarkResult& result, const std::string& note) {
+		std::cout << "  " << result.GetKey() << ": " << result.secondsPerItem * 1.0e9 << " ns/" << result.unit << ", "
+			<< 1.0e-6 / result.secondsPerItem << " M" << result.unit << "s/s, +-" << result.deviation / result.secondsPerItem * 100.0 << "%";
+		if (!note.empty()) std::cout << ", " << note;
+		std::cout << std::endl;
+	}
+	static size_t GetChunkCount(size_t itemCount) {
+		return (itemCount + CHUNK_ITEMS - 1) / CHUNK_ITEMS;
+	}
+	static std::vector<float> RandomFloats(size_t count, float min, float max, unsigned int seed) {
+		std::mt19937 generator = std::mt19937(seed);
+		std::uniform_real_distribution<float> distribution = std::uniform_real_distribution<float>(min, max);
+		std::vector<float> values(count);
+		for (float& value : values) value = distribution(generator);
+		return values;
+	}
+	static std::vector<Isa> GetSupportedIsas(const std::string& kernel) {
+		std::vector<Isa> isas;
+		for (Isa isa : { Isa::scalar, Isa::avx2, Isa::avx512 }) {
+			if (CpuFeatures::IsSupported(isa)) isas.push_back(isa);
+			else std::cout << "  " << kernel << "/" << CpuFeatures::GetName(isa) << ": not supported" << std::endl;
+		}
+		return isas;
+	}
+	static std::string DeviationNote(float maxError) {
+		std::ostringstream note;
+		note << "max deviation from scalar " << maxError;
+		return note.str();
+	}
+	// Rays from the default camera position in every direction, so about half of them miss the volume.
+	static void AddHitVolumeCases(std::vector<MicroBenchmarkCase>& cases, size_t itemCount) {
+		typedef void (*BatchFunction)(const CpuRenderContext&, const float*, const float*, const float*, float*, float*, size_t);
+
+		std::shared_ptr<CpuRenderContext> context = std::make_shared<CpuRenderContext>();
+		context->cameraPos = glm::vec3(0.0f, 0.0f, 35.0f);
+		context->volumeMin = glm::vec3(-10.0f);
+		context->volumeMax = glm::vec3(10.0f);
+		std::shared_ptr<std::vector<float>> directions = std::make_shared<std::vector<float>>(RandomFloats(itemCount * 3, -1.0f, 1.0f, 1));
+
+		std::vector<float> referenceMin(itemCount), referenceMax(itemCount);
+		const float* dir = directions->data();
+		HitVolumeBatchScalar(*context, dir, dir + itemCount, dir + itemCount * 2, referenceMin.data(), referenceMax.data(), itemCount);
+
+		for (Isa isa : GetSupportedIsas("hitvolume")) {
+			BatchFunction batchFunction = isa == Isa::avx512 ? HitVolumeBatchAVX512 : isa == Isa::avx2 ? HitVolumeBatchAVX2 : HitVolumeBatchScalar;
+			std::shared_ptr<std::vector<float>> out = std::make_shared<std::vector<float>>(itemCount * 2);
+
+			// Misses leave arbitrary distances behind, so only hits are compared.
+			batchFunction(*context, dir, dir + itemCount, dir + itemCount * 2, out->data(), out->data() + itemCount, itemCount);
+			float maxError = 0.0f;
+			for (size_t i = 0; i < itemCount; i++) {
+				if (referenceMin[i] > referenceMax[i]) continue;
+				maxError = std::max(maxError, std::abs((*out)[i] - referenceMin[i]));
+				maxError = std::max(maxError, std::abs((*out)[itemCount + i] - referenceMax[i]));
+			}
+
+			MicroBenchmarkCase benchmarkCase;
+			benchmarkCase.name = "hitvolume/" + CpuFeatures::GetName(isa);
+			benchmarkCase.unit = "ray";
+			benchmarkCase.itemCount = itemCount;
+			benchmarkCase.chunkCount = GetChunkCount(itemCount);
+			benchmarkCase.note = DeviationNote(maxError);
+			benchmarkCase.run = [=](size_t chunk) {
+				size_t begin = chunk * CHUNK_ITEMS, count = std::min((size_t)CHUNK_ITEMS, itemCount - begin);
+				const float* dir = directions->data();
+				batchFunction(*context, dir + begin, dir + itemCount + begin, dir + itemCount * 2 + begin,
+					out->data() + begin, out->data() + itemCount + begin, count);
+			};
+			cases.push_back(benchmarkCase);
+		}
+	}
+	// Same range the march covers: volume coordinates scaled by the noise frequency.
+	static void AddNoiseCases(std::vector<MicroBenchmarkCase>& cases, size_t itemCount) {
+		std::shared_ptr<std::vector<float>> points = std::make_shared<std::vector<float>>(RandomFloats(itemCount * 3, -60.0f, 60.0f, 1));
+		const float* p = points->data();
+		std::vector<float> reference(itemCount);
+		Noise::GetBatchFunction(Isa::scalar)(p, p + itemCount, p + itemCount * 2, reference.data(), itemCount);
+
+		for (Isa isa : GetSupportedIsas("cnoise")) {
+			Noise::BatchFunction batchFunction = Noise::GetBatchFunction(isa);
+			std::shared_ptr<std::vector<float>> out = std::make_shared<std::vector<float>>(itemCount);
+
+			batchFunction(p, p + itemCount, p + itemCount * 2, out->data(), itemCount);
+			float maxError = 0.0f;
+			for (size_t i = 0; i < itemCount; i++) maxError = std::max(maxError, std::abs((*out)[i] - reference[i]));
+
+			MicroBenchmarkCase benchmarkCase;
+			benchmarkCase.name = "cnoise/" + CpuFeatures::GetName(isa);
+			benchmarkCase.unit = "point";
+			benchmarkCase.itemCount = itemCount;
+			benchmarkCase.chunkCount = GetChunkCount(itemCount);
+			benchmarkCase.note = DeviationNote(maxError);
+			benchmarkCase.run = [=](size_t chunk) {
+				size_t begin = chunk * CHUNK_ITEMS, count = std::min((size_t)CHUNK_ITEMS, itemCount - begin);
+				const float* p = points->data();
+				batchFunction(p + begin, p + itemCount + begin, p + itemCount * 2 + begin, out->data() + begin, count);
+			};
+			cases.push_back(benchmarkCase);
+		}
+	}
+	// Random RGBE byte planes, as HDRReader converts them after run-length decoding.
+	static void AddRGBECases(std::vector<MicroBenchmarkCase>& cases, size_t itemCount) {
+		std::shared_ptr<std::vector<uint8_t>> planes = std::make_shared<std::vector<uint8_t>>(itemCount * 4);
+		std::mt19937 random(3);
+		for (uint8_t& value : *planes) value = (uint8_t)(random() & 0xFF);
+		const uint8_t* p = planes->data();
+		std::vector<float> reference(itemCount * 3);
+		RGBE::GetToFloatFunction(Isa::scalar)(p, p + itemCount, p + itemCount * 2, p + itemCount * 3, reference.data(), itemCount);
+
+		for (Isa isa : GetSupportedIsas("rgbe")) {
+			RGBE::ToFloatFunction toFloatFunction = RGBE::GetToFloatFunction(isa);
+			std::shared_ptr<std::vector<float>> out = std::make_shared<std::vector<float>>(itemCount * 3);
+
+			toFloatFunction(p, p + itemCount, p + itemCount * 2, p + itemCount * 3, out->data(), itemCount);
+			float maxError = 0.0f;
+			for (size_t i = 0; i < itemCount * 3; i++) maxError = std::max(maxError, std::abs((*out)[i] - reference[i]));
+
+			MicroBenchmarkCase benchmarkCase;
+			benchmarkCase.name = "rgbe/" + CpuFeatures::GetName(isa);
+			benchmarkCase.unit = "pixel";
+			benchmarkCase.itemCount = itemCount;
+			benchmarkCase.chunkCount = GetChunkCount(itemCount);
+			benchmarkCase.note = DeviationNote(maxError);
+			benchmarkCase.run = [=](size_t chunk) {
+				size_t begin = chunk * CHUNK_ITEMS, count = std::min((size_t)CHUNK_ITEMS, itemCount - begin);
+				const uint8_t* p = planes->data() + begin;
+				toFloatFunction(p, p + itemCount, p + itemCount * 2, p + itemCount * 3, out->data() + begin * 3, count);
+			};
+			cases.push_back(benchmarkCase);
+		}
+	}
+	// A camera update as ProcessInput() does it: yaw around the world axis, move along the local one, rebuild the model matrix.
+	static void AddGameObjectCase(std::vector<MicroBenchmarkCase>& cases, size_t itemCount) {
+		size_t objectCount = std::min(itemCount, (size_t)1 << 16);
+		std::shared_ptr<std::vector<GameObject>> objects = std::make_shared<std::vector<GameObject>>(objectCount);
+		std::shared_ptr<std::vector<glm::mat4>> out = std::make_shared<std::vector<glm::mat4>>(objectCount);
+
+		MicroBenchmarkCase benchmarkCase;
+		benchmarkCase.name = "gameobject";
+		benchmarkCase.unit = "update";
+		benchmarkCase.itemCount = objectCount;
+		benchmarkCase.chunkCount = GetChunkCount(objectCount);
+		benchmarkCase.threaded = false;
+		benchmarkCase.run = [=](size_t chunk) {
+			size_t begin = chunk * CHUNK_ITEMS, end = std::min((size_t)(begin + CHUNK_ITEMS), objectCount);
+			for (size_t i = begin; i < end; i++) {
+				GameObject& object = (*objects)[i];
+				object.Rotate(0.5f, glm::vec3(0.0f, 1.0f, 0.0f), Space::global);
+				object.Translate(glm::vec3(0.0f, 0.0f, -0.01f), Space::local);
+				(*out)[i] = object.GetModelMatrix();
+			}
+		};
+		cases.push_back(benchmarkCase);
+	}
+	// Decodes the file from memory, so only the RGBE decode and float conversion are timed. One decode
+	// per chunk, each on a single thread, with HDRReader and, for comparison, stb_image.
+	static void AddHDRDecodeCase(std::vector<MicroBenchmarkCase>& cases, const std::string& path) {
+		std::ifstream file = std::ifstream(path, std::ios::binary);
+		std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>(
+			std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		int width = 0, height = 0, channelCount = 0;
+		if (bytes->empty() || !stbi_info_from_memory(bytes->data(), (int)bytes->size(), &width, &height, &channelCount)) {
+			std::cout << "  hdr-decode: could not read <" << path << ">, skipped" << std::endl;
+			return;
+		}
+		const size_t decodeCount = 4;
+
+		MicroBenchmarkCase benchmarkCase;
+		benchmarkCase.name = "hdr-decode";
+		benchmarkCase.unit = "pixel";
+		benchmarkCase.itemCount = decodeCount * width * height;
+		benchmarkCase.chunkCount = decodeCount;
+		benchmarkCase.run = [=](size_t) {
+			std::vector<float> pixels;
+			int w, h;
+			HDRReader::Decode(bytes->data(), bytes->size(), pixels, w, h, 1);
+		};
+		cases.push_back(benchmarkCase);
+
+		benchmarkCase.name = "hdr-decode-stb";
+		benchmarkCase.run = [=](size_t) {
+			int w, h, n;
+			float* pixels = stbi_loadf_from_memory(bytes->data(), (int)bytes->size(), &w, &h, &n, 0);
+			stbi_image_free(pixels);
+		};
+		cases.push_back(benchmarkCase);
+	}
+	// A 1024 x 512 gradient encoded in FrameCapture's scanline blocks.
+	static void AddEncodeCase(std::vector<MicroBenchmarkCase>& cases, ImageFormat format) {
+		const unsigned int width = 1024, height = 512, blockRows = 64;
+		std::shared_ptr<Image> image = std::make_shared<Image>(width, height);
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				float* pixel = image->Pixel(x, y);
+				pixel[0] = (float)x / width;
+				pixel[1] = (float)y / height;
+				pixel[2] = 0.25f;
+			}
+		}
+		std::shared_ptr<std::vector<ImageWriter::EncodedBlock>> blocks = std::make_shared<std::vector<ImageWriter::EncodedBlock>>(height / blockRows);
+
+		MicroBenchmarkCase benchmarkCase;
+		benchmarkCase.name = std::string("encode-") + ImageWriter::GetExtension(format);
+		benchmarkCase.unit = "pixel";
+		benchmarkCase.itemCount = (size_t)width * height;
+		benchmarkCase.chunkCount = blocks->size();
+		benchmarkCase.run = [=](size_t chunk) {
+			(*blocks)[chunk] = ImageWriter::EncodeBlock(format, ImageView(*image), (unsigned int)chunk * blockRows, (unsigned int)(chunk + 1) * blockRows);
+		};
+		cases.push_back(benchmarkCase);
+	}
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+
+#include "Simd.h"
+#include "CpuFeatures.h"
+
+// CPU port of cnoise() from Render.comp: Stefan Gustavson's classic Perlin 3D noise with
+// mod 289 permutation polynomials. The operation order follows the GLSL source so results
+// match the GPU to within floating point reassociation.
+namespace Noise {
+	template<class F> F Permute(F x) {
+		return Mod((x * F(34.0f) + F(1.0f)) * x, 289.0f);
+	}
+	template<class F> F TaylorInvSqrt(F r) {
+		return F(1.79284291400159f) - F(0.85373472095314f) * r;
+	}
+	template<class F> F Fade(F t) {
+		return t * t * t * (t * (t * F(6.0f) - F(15.0f)) + F(10.0f));
+	}
+	template<class F> F Mix(F a, F b, F t) {
+		return a * (F(1.0f) - t) + b * t;
+	}
+	// Gradients for the four corners of one z slice, normalized in place.
+	template<class F> void Gradients(const F ixy[4], F gx[4], F gy[4], F gz[4]) {
+		for (int i = 0; i < 4; i++) {
+			F x = ixy[i] / F(7.0f);
+			gy[i] = Fract(Floor(x) / F(7.0f)) - F(0.5f);
+			gx[i] = Fract(x);
+			gz[i] = F(0.5f) - Abs(gx[i]) - Abs(gy[i]);
+			F sz = Step(gz[i], F(0.0f));
+			gx[i] = gx[i] - sz * (Step(F(0.0f), gx[i]) - F(0.5f));
+			gy[i] = gy[i] - sz * (Step(F(0.0f), gy[i]) - F(0.5f));
+
+			F norm = TaylorInvSqrt(gx[i] * gx[i] + gy[i] * gy[i] + gz[i] * gz[i]);
+			gx[i] = gx[i] * norm;
+			gy[i] = gy[i] * norm;
+			gz[i] = gz[i] * norm;
+		}
+	}
+	template<class F> F CNoise(F px, F py, F pz) {
+		F pi0x = Floor(px), pi0y = Floor(py), pi0z = Floor(pz);
+		F pi1x = Mod(pi0x + F(1.0f), 289.0f), pi1y = Mod(pi0y + F(1.0f), 289.0f), pi1z = Mod(pi0z + F(1.0f), 289.0f);
+		pi0x = Mod(pi0x, 289.0f);
+		pi0y = Mod(pi0y, 289.0f);
+		pi0z = Mod(pi0z, 289.0f);
+		F pf0x = Fract(px), pf0y = Fract(py), pf0z = Fract(pz);
+		F pf1x = pf0x - F(1.0f), pf1y = pf0y - F(1.0f), pf1z = pf0z - F(1.0f);
+
+		// Corner order matches the GLSL vec4 lanes: (x0,y0), (x1,y0), (x0,y1), (x1,y1).
+		F ix[4] = { pi0x, pi1x, pi0x, pi1x };
+		F iy[4] = { pi0y, pi0y, pi1y, pi1y };
+
+		F ixy[4], ixy0[4], ixy1[4];
+		for (int i = 0; i < 4; i++) {
+			ixy[i] = Permute(Permute(ix[i]) + iy[i]);
+			ixy0[i] = Permute(ixy[i] + pi0z);
+			ixy1[i] = Permute(ixy[i] + pi1z);
+		}
+		F gx0[4], gy0[4], gz0[4], gx1[4], gy1[4], gz1[4];
+		Gradients(ixy0, gx0, gy0, gz0);
+		Gradients(ixy1, gx1, gy1, gz1);
+
+		F fx[4] = { pf0x, pf1x, pf0x, pf1x };
+		F fy[4] = { pf0y, pf0y, pf1y, pf1y };
+		F n0[4], n1[4];
+		for (int i = 0; i < 4; i++) {
+			n0[i] = gx0[i] * fx[i] + gy0[i] * fy[i] + gz0[i] * pf0z;
+			n1[i] = gx1[i] * fx[i] + gy1[i] * fy[i] + gz1[i] * pf1z;
+		}
+
+		F fadeX = Fade(pf0x), fadeY = Fade(pf0y), fadeZ = Fade(pf0z);
+		F nz[4];
+		for (int i = 0; i < 4; i++) nz[i] = Mix(n0[i], n1[i], fadeZ);
+		F nyz0 = Mix(nz[0], nz[2], fadeY);
+		F nyz1 = Mix(nz[1], nz[3], fadeY);
+		return F(2.2f) * Mix(nyz0, nyz1, fadeX);
+	}
+	// Evaluates count points from separate x, y and z arrays, F::width at a time. The tail is
+	// padded into one last full packet so every point takes the same code path.
+	template<class F> void CNoisePackets(const float* x, const float* y, const float* z, float* out, size_t count) {
+		size_t i = 0;
+		for (; i + F::width <= count; i += F::width) CNoise(F::Load(x + i), F::Load(y + i), F::Load(z + i)).Store(out + i);
+		if (i == count) return;
+
+		float tail[4][F::width] = {};
+		for (size_t j = i; j < count; j++) {
+			tail[0][j - i] = x[j];
+			tail[1][j - i] = y[j];
+			tail[2][j - i] = z[j];
+		}
+		CNoise(F::Load(tail[0]), F::Load(tail[1]), F::Load(tail[2])).Store(tail[3]);
+		for (size_t j = i; j < count; j++) out[j] = tail[3][j - i];
+	}
+
+	typedef void (*BatchFunction)(const float* x, const float* y, const float* z, float* out, size_t count);
+}
+
+// Per instruction set batch entry points, built in their own translation units like the render kernels.
+void CNoiseBatchScalar(const float* x, const float* y, const float* z, float* out, size_t count);
+void CNoiseBatchAVX2(const float* x, const float* y, const float* z, float* out, size_t count);
+void CNoiseBatchAVX512(const float* x, const float* y, const float* z, float* out, size_t count);
+
+namespace Noise {
+	inline BatchFunction GetBatchFunction(Isa isa) {
+		if (!CpuFeatures::IsSupported(isa)) isa = CpuFeatures::DetectIsa();
+
+		if (isa == Isa::avx512) return CNoiseBatchAVX512;
+		if (isa == Isa::avx2) return CNoiseBatchAVX2;
+		return CNoiseBatchScalar;
+	}
+	// cnoise() for count points, dispatched once to the widest instruction set available.
+	inline void CNoiseBatch(const float* x, const float* y, const float* z, float* out, size_t count) {
+		static const BatchFunction batchFunction = GetBatchFunction(CpuFeatures::DetectIsa());
+		batchFunction(x, y, z, out, count);
+	}
+}
@@ -0,0 +1,9 @@
+#include "Noise.h"
+
+#if !defined(__AVX2__)
+#error "NoiseKernelAVX2.cpp must be compiled with AVX2 code generation enabled"
+#endif
+
+void CNoiseBatchAVX2(const float* x, const float* y, const float* z, float* out, size_t count) {
+	Noise::CNoisePackets<Float8>(x, y, z, out, count);
+}
@@ -0,0 +1,9 @@
+#include "Noise.h"
+
+#if !defined(__AVX512F__)
+#error "NoiseKernelAVX512.cpp must be compiled with AVX512 code generation enabled"
+#endif
+
+void CNoiseBatchAVX512(const float* x, const float* y, const float* z, float* out, size_t count) {
+	Noise::CNoisePackets<Float16>(x, y, z, out, count);
+}
@@ -0,0 +1,5 @@
+#include "Noise.h"
+
+void CNoiseBatchScalar(const float* x, const float* y, const float* z, float* out, size_t count) {
+	Noise::CNoisePackets<Float1>(x, y, z, out, count);
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "TileScheduler.h"
+
+// Octahedral environment maps: the unit sphere folded onto a square, y up, upper hemisphere in the
+// inner diamond. A lookup is a handful of adds and one divide instead of atan and asin, texels cover
+// nearly equal solid angles (within a factor of about 3, against unbounded at the poles of an
+// equirectangular map), and with a power of two size every mip level folds the same way, so a mip
+// chain filters over the texel's footprint on the sphere. OctahedralEncode() in Render.comp must
+// match Encode().
+namespace Octahedral {
+	// Rows resampled as one task.
+	static const int BLOCK_ROWS = 16;
+
+	// Direction to [0, 1]^2.
+	inline glm::vec2 Encode(glm::vec3 direction) {
+		direction /= std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+		glm::vec2 p(direction.x, direction.z);
+		if (direction.y < 0.0f) {
+			p = glm::vec2((1.0f - std::abs(direction.z)) * (direction.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(direction.x)) * (direction.z >= 0.0f ? 1.0f : -1.0f));
+		}
+		return p * 0.5f + 0.5f;
+	}
+	// [0, 1]^2 to a direction, not normalized: |x| + |y| + |z| = 1.
+	inline glm::vec3 Decode(glm::vec2 uv) {
+		glm::vec2 p = uv * 2.0f - 1.0f;
+		glm::vec3 direction(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+		if (direction.y < 0.0f) {
+			direction.x = (1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+			direction.z = (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return direction;
+	}
+	// Relative solid angle of the texel around uv. The fold maps each octant onto a face of the
+	// octahedron without stretching, so this is the face's 1 / r^3 falloff.
+	inline float GetSolidAngleWeight(glm::vec2 uv) {
+		float length = glm::length(Decode(uv));
+		return 1.0f / (length * length * length);
+	}
+	// Side of the square map for an equirectangular source of the given height: a power of two at least
+	// as tall, which resolves at least as much as the source at the equator with about half the texels.
+	inline int GetSize(int equirectHeight) {
+		int size = 1;
+		while (size < equirectHeight) size *= 2;
+		return size;
+	}
+	// Bilinear equirectangular lookup, wrapping around the horizon and clamped at the poles. Same
+	// parametrization as the old equirectangular SampleEnvironmentMap().
+	inline glm::vec3 SampleEquirect(const float* rgb, int width, int height, glm::vec3 direction) {
+		direction = glm::normalize(direction);
+		float u = std::atan2(direction.z, direction.x) / (2.0f * glm::pi<float>()) + 0.5f;
+		float v = std::asin(glm::clamp(direction.y, -1.0f, 1.0f)) / glm::pi<float>() + 0.5f;
+		float x = u * width - 0.5f, y = glm::clamp(v * height - 0.5f, 0.0f, (float)(height - 1));
+		int x0 = (int)std::floor(x), y0 = (int)y;
+		float fx = x - x0, fy = y - y0;
+		int x1 = x0 + 1, y1 = std::min(y0 + 1, height - 1);
+		x0 = (x0 % width + width) % width;
+		x1 = x1 % width;
+		const float* p00 = rgb + ((size_t)y0 * width + x0) * 3;
+		const float* p10 = rgb + ((size_t)y0 * width + x1) * 3;
+		const float* p01 = rgb + ((size_t)y1 * width + x0) * 3;
+		const float* p11 = rgb + ((size_t)y1 * width + x1) * 3;
+		glm::vec3 color;
+		for (int c = 0; c < 3; c++) {
+			color[c] = (p00[c] * (1.0f - fx) + p10[c] * fx) * (1.0f - fy) + (p01[c] * (1.0f - fx) + p11[c] * fx) * fy;
+		}
+		return color;
+	}
+	// Resamples an equirectangular RGB image, bottom row first, into a size x size octahedral one with
+	// 2x2 samples per texel.
+	inline void FromEquirect(const std::vector<float>& equirect, int width, int height, int size, std::vector<float>& octahedral) {
+		octahedral.resize((size_t)size * size * 3);
+		TileScheduler scheduler((size + BLOCK_ROWS - 1) / BLOCK_ROWS);
+		scheduler.Run([&](size_t task) {
+			int end = std::min(size, (int)(task + 1) * BLOCK_ROWS);
+			for (int y = (int)task * BLOCK_ROWS; y < end; y++) {
+				for (int x = 0; x < size; x++) {
+					glm::vec3 color(0.0f);
+					for (int sample = 0; sample < 4; sample++) {
+						glm::vec2 uv((x + 0.25f + 0.5f * (sample & 1)) / size, (y + 0.25f + 0.5f * (sample >> 1)) / size);
+						color += SampleEquirect(equirect.data(), width, height, Decode(uv)) * 0.25f;
+					}
+					float* texel = octahedral.data() + ((size_t)y * size + x) * 3;
+					texel[0] = color.r;
+					texel[1] = color.g;
+					texel[2] = color.b;
+				}
+			}
+		});
+	}
+	// Solid angle weights of the texels of a size x size map, for Downsample().
+	inline void GetSolidAngleWeights(int size, std::vector<float>& weights) {
+		weights.resize((size_t)size * size);
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) weights[(size_t)y * size + x] = GetSolidAngleWeight(glm::vec2((x + 0.5f) / size, (y + 0.5f) / size));
+		}
+	}
+	// The next mip level: every texel is the solid angle weighted mean of the four it covers, so each
+	// level is the radiance averaged over its texels' footprints on the sphere. The weights are summed
+	// along with the texels, since the falloff is not linear enough over a coarse texel to take it at
+	// the centre.
+	inline void Downsample(std::vector<float>& pixels, std::vector<float>& weights, int& size) {
+		int half = std::max(1, size / 2);
+		std::vector<float> next((size_t)half * half * 3), nextWeights((size_t)half * half);
+		for (int y = 0; y < half; y++) {
+			for (int x = 0; x < half; x++) {
+				glm::vec3 sum(0.0f);
+				float weightSum = 0.0f;
+				for (int child = 0; child < 4; child++) {
+					size_t index = (size_t)std::min(2 * y + (child >> 1), size - 1) * size + std::min(2 * x + (child & 1), size - 1);
+					const float* texel = pixels.data() + index * 3;
+					sum += glm::vec3(texel[0], texel[1], texel[2]) * weights[index];
+					weightSum += weights[index];
+				}
+				size_t index = (size_t)y * half + x;
+				for (int c = 0; c < 3; c++) next[index * 3 + c] = sum[c] / weightSum;
+				nextWeights[index] = weightSum;
+			}
+		}
+		pixels.swap(next);
+		weights.swap(nextWeights);
+		size = half;
+	}
+}
@@ -0,0 +1,291 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Scoped CPU zones and GPU timer scopes on one timeline, written out as a Chrome trace for
+// chrome://tracing or ui.perfetto.dev. While the profiler is off a zone costs one flag check. Every
+// thread records into its own ring, so recording never locks; a full ring drops its oldest zones.
+// GPU zones are timestamp query pairs on the render thread, collected a few frames later without
+// stalling and moved onto the CPU clock by a calibration taken at the first GPU zone.
+//
+// Zone names must outlive the profiler: string literals, or Intern() for built names.
+class Profiler {
+public:
+	// Zones kept per thread, and on the GPU track.
+	static const size_t RING_CAPACITY = 1 << 16;
+public:
+	static Profiler& Get() {
+		static Profiler profiler;
+		return profiler;
+	}
+	void Start() {
+		std::lock_guard<std::mutex> lock(mutex);
+		epoch = Clock();
+		for (std::unique_ptr<ThreadRing>& ring : rings) ring->written.store(0);
+		gpuZones.clear();
+		enabled.store(true, std::memory_order_relaxed);
+	}
+	// Resolve GPU zones with FinishGpuZones() first; those still pending are dropped.
+	void Stop() {
+		enabled.store(false, std::memory_order_relaxed);
+	}
+	bool IsEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+	// Nanoseconds on the steady clock; zones are stored relative to Start().
+	static int64_t Clock() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	void Record(const char* name, int64_t begin, int64_t end) {
+		ThreadRing& ring = GetThreadRing();
+		uint64_t written = ring.written.load(std::memory_order_relaxed);
+		ring.zones[written % RING_CAPACITY] = Zone{ name, begin - epoch, end - epoch };
+		ring.written.store(written + 1, std::memory_order_release);
+	}
+	// Names the calling thread's track. Cheap enough to call at thread start whether or not profiling is on.
+	static void SetThreadName(const std::string& name) {
+		GetThreadName() = name;
+	}
+	// A copy of name that lives as long as the profiler.
+	const char* Intern(const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return internedNames.insert(name).first->c_str();
+	}
+
+	// Render thread only, with the GL context current. Returns the zone to pass to EndGpuZone(), or -1 while off.
+	int BeginGpuZone(const char* name) {
+		if (!IsEnabled()) return -1;
+		CollectGpuZones(false);
+		if (!gpuCalibrated) {
+			GLint64 gpuNow = 0;
+			glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+			gpuOffset = Clock() - gpuNow;
+			gpuCalibrated = true;
+		}
+		PendingGpuZone zone;
+		zone.name = name;
+		zone.beginQuery = AcquireQuery();
+		zone.endQuery = AcquireQuery();
+		zone.ended = false;
+		glQueryCounter(zone.beginQuery, GL_TIMESTAMP);
+		pendingGpuZones.push_back(zone);
+		return (int)(pendingGpuZoneCount++);
+	}
+	void EndGpuZone(int zone) {
+		if (zone < 0) return;
+		size_t first = pendingGpuZoneCount - pendingGpuZones.size();
+		if ((size_t)zone < first) return;
+		glQueryCounter(pendingGpuZones[zone - first].endQuery, GL_TIMESTAMP);
+		pendingGpuZones[zone - first].ended = true;
+	}
+	// Waits for every GPU zone and releases the queries. Call before the GL context goes away.
+	void FinishGpuZones() {
+		CollectGpuZones(true);
+		if (!freeQueries.empty()) glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+		freeQueries.clear();
+		gpuCalibrated = false;
+	}
+
+	// Chrome trace event format: one complete ("X") event per zone, microseconds since Start(), one
+	// track per thread and one for the GPU. Safe while threads are still recording.
+	bool WriteChromeTrace(const std::string& path) {
+		std::ofstream file = std::ofstream(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write trace <" << path << ">" << std::endl;
+			return false;
+		}
+		file.precision(3);
+		file << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Clerestory\"}},\n"
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+		size_t zoneCount = 0;
+		for (const Zone& zone : gpuZones) WriteZone(file, zone, 0, "gpu");
+		zoneCount += gpuZones.size();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < rings.size(); i++) {
+			ThreadRing& ring = *rings[i];
+			unsigned int tid = (unsigned int)i + 1;
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"" << Escape(ring.name) << "\"}}";
+
+			uint64_t written = ring.written.load(std::memory_order_acquire);
+			uint64_t first = written > RING_CAPACITY ? written - RING_CAPACITY : 0;
+			std::vector<Zone> zones;
+			for (uint64_t j = first; j < written; j++) zones.push_back(ring.zones[j % RING_CAPACITY]);
+			// Zones the owner overwrote while they were being copied may be torn; leave them out.
+			uint64_t overwritten = ring.written.load(std::memory_order_acquire);
+			size_t skip = overwritten > RING_CAPACITY + first ? (size_t)std::min<uint64_t>(overwritten - RING_CAPACITY - first, zones.size()) : 0;
+			for (size_t j = skip; j < zones.size(); j++) WriteZone(file, zones[j], tid, "cpu");
+			zoneCount += zones.size() - skip;
+		}
+		file << "\n]}\n";
+		if (file.fail()) {
+			std::cout << "ERROR: Could not write trace <" << path << ">" << std::endl;
+			return false;
+		}
+		std::cout << "Wrote " << zoneCount << " zones on " << rings.size() << " threads and the GPU to <" << path << ">" << std::endl;
+		return true;
+	}
+private:
+	struct Zone {
+		const char* name;
+		int64_t begin, end;
+	};
+	// Written only by its thread; written counts every zone ever recorded.
+	struct ThreadRing {
+		std::string name;
+		std::unique_ptr<Zone[]> zones;
+		std::atomic<uint64_t> written{ 0 };
+	};
+	struct PendingGpuZone {
+		const char* name;
+		GLuint beginQuery, endQuery;
+		bool ended;
+	};
+
+	std::atomic<bool> enabled{ false };
+	int64_t epoch = 0;
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadRing>> rings;
+	std::set<std::string> internedNames;
+
+	// Render thread state.
+	std::deque<PendingGpuZone> pendingGpuZones;
+	// Zones ever begun, so EndGpuZone() can find its zone after older ones were collected.
+	size_t pendingGpuZoneCount = 0;
+	std::vector<GLuint> freeQueries;
+	std::deque<Zone> gpuZones;
+	bool gpuCalibrated = false;
+	int64_t gpuOffset = 0;
+private:
+	Profiler() = default;
+
+	static std::string& GetThreadName() {
+		static thread_local std::string name;
+		return name;
+	}
+	// Created on the thread's first zone, and kept after the thread exits so its zones can still be written.
+	ThreadRing& GetThreadRing() {
+		static thread_local ThreadRing* ring = nullptr;
+		if (ring) return *ring;
+
+		std::unique_ptr<ThreadRing> created(new ThreadRing());
+		created->zones.reset(new Zone[RING_CAPACITY]);
+		std::lock_guard<std::mutex> lock(mutex);
+		created->name = GetThreadName().empty() ? "Thread " + std::to_string(rings.size() + 1) : GetThreadName();
+		rings.push_back(std::move(created));
+		ring = rings.back().get();
+		return *ring;
+	}
+	GLuint AcquireQuery() {
+		if (freeQueries.empty()) {
+			freeQueries.resize(64);
+			glGenQueries((GLsizei)freeQueries.size(), freeQueries.data());
+		}
+		GLuint query = freeQueries.back();
+		freeQueries.pop_back();
+		return query;
+	}
+	// Oldest first, stopping at the first zone still open or, unless wait is set, not finished by the GPU.
+	void CollectGpuZones(bool wait) {
+		while (!pendingGpuZones.empty()) {
+			PendingGpuZone& zone = pendingGpuZones.front();
+			if (!zone.ended) return;
+			if (!wait) {
+				GLint available = 0;
+				glGetQueryObjectiv(zone.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available) return;
+			}
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(zone.beginQuery, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(zone.endQuery, GL_QUERY_RESULT, &end);
+			gpuZones.push_back(Zone{ zone.name, (int64_t)begin + gpuOffset - epoch, (int64_t)end + gpuOffset - epoch });
+			if (gpuZones.size() > RING_CAPACITY) gpuZones.pop_front();
+
+			freeQueries.push_back(zone.beginQuery);
+			freeQueries.push_back(zone.endQuery);
+			pendingGpuZones.pop_front();
+		}
+	}
+	// Text as the contents of a JSON string.
+	static std::string Escape(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') escaped += '\\';
+			if ((unsigned char)c >= 0x20) escaped += c;
+		}
+		return escaped;
+	}
+	static void WriteZone(std::ofstream& file, const Zone& zone, unsigned int tid, const char* category) {
+		file << ",\n{\"name\":\"" << Escape(zone.name) << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+			<< ",\"ts\":" << zone.begin / 1000.0 << ",\"dur\":" << std::max<int64_t>(zone.end - zone.begin, 0) / 1000.0 << "}";
+	}
+};
+
+// Records the enclosing scope as a zone on the calling thread's track.
+class ProfileZone {
+public:
+	ProfileZone(const char* name) {
+		if (!Profiler::Get().IsEnabled()) return;
+		this->name = name;
+		begin = Profiler::Clock();
+	}
+	~ProfileZone() {
+		if (name) Profiler::Get().Record(name, begin, Profiler::Clock());
+	}
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+private:
+	const char* name = nullptr;
+	int64_t begin = 0;
+};
+
+// Records the GPU work submitted in the enclosing scope on the GPU track. Render thread only.
+class GpuProfileZone {
+public:
+	GpuProfileZone(const char* name) {
+		zone = Profiler::Get().BeginGpuZone(name);
+	}
+	~GpuProfileZone() {
+		Profiler::Get().EndGpuZone(zone);
+	}
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+private:
+	int zone;
+};
+
+// Profiles from construction to destruction and then writes the trace to path; does nothing for an empty path.
+class ProfileCapture {
+public:
+	ProfileCapture(const std::string& path) {
+		this->path = path;
+		if (!path.empty()) Profiler::Get().Start();
+	}
+	~ProfileCapture() {
+		if (path.empty()) return;
+		Profiler::Get().Stop();
+		Profiler::Get().WriteChromeTrace(path);
+	}
+	ProfileCapture(const ProfileCapture&) = delete;
+	ProfileCapture& operator=(const ProfileCapture&) = delete;
+private:
+	std::string path;
+};
+
+#define PROFILE_CONCATENATE_INNER(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCATENATE(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCATENATE(gpuProfileZone, __LINE__)(name)
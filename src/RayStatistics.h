@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// What the march pass writes per pixel. Every view but radiance is a count per ray, averaged over
+// the accumulated samples and presented as a heatmap.
+enum class DebugView {
+	radiance,
+	// Steps along the view ray.
+	steps,
+	// Noise evaluations, view and shadow rays together.
+	noise,
+	// Steps of all the shadow rays.
+	shadowSteps,
+	// The view ray step at which transmittance falls below RayStatistics::TERMINATION_TRANSMITTANCE,
+	// where early termination would stop; the full step count if it never does.
+	termination
+};
+
+// Totals over every pixel of the samples rendered while statistics were on, read back from the
+// counters Render.comp keeps. Hybrid renders only count the GPU's rows.
+struct RayStatistics {
+	// Transmittance below which a view ray could stop without visibly changing the image.
+	static constexpr float TERMINATION_TRANSMITTANCE = 0.01f;
+	// 64 bit counters in Render.comp, in the order of the fields below.
+	static const unsigned int COUNTER_COUNT = 7;
+
+	uint64_t rays = 0;
+	// Rays that pass through the volume.
+	uint64_t volumeRays = 0;
+	uint64_t steps = 0;
+	// Steps at zero density, which empty space skipping could leave out.
+	uint64_t emptySteps = 0;
+	// Steps after transmittance fell below TERMINATION_TRANSMITTANCE, which early termination would leave out.
+	uint64_t terminableSteps = 0;
+	uint64_t shadowSteps = 0;
+	uint64_t noiseEvaluations = 0;
+	unsigned int sampleCount = 0;
+
+	// Adds one sample's counters as Render.comp stores them: (low, high) word pairs.
+	void Add(const uint32_t* counters) {
+		uint64_t* fields[COUNTER_COUNT] = { &rays, &volumeRays, &steps, &emptySteps, &terminableSteps, &shadowSteps, &noiseEvaluations };
+		for (unsigned int i = 0; i < COUNTER_COUNT; i++) *fields[i] += counters[i * 2] | ((uint64_t)counters[i * 2 + 1] << 32);
+		sampleCount++;
+	}
+
+	static bool ParseDebugView(const std::string& name, DebugView& view) {
+		for (int i = 0; i <= (int)DebugView::termination; i++) {
+			if (name == GetDebugViewName((DebugView)i)) {
+				view = (DebugView)i;
+				return true;
+			}
+		}
+		return false;
+	}
+	static const char* GetDebugViewName(DebugView view) {
+		switch (view) {
+		case DebugView::radiance:    return "radiance";
+		case DebugView::steps:       return "steps";
+		case DebugView::noise:       return "noise";
+		case DebugView::shadowSteps: return "shadow-steps";
+		case DebugView::termination: return "termination";
+		}
+		return "radiance";
+	}
+	// The view after view, wrapping around, for cycling through them.
+	static DebugView GetNextDebugView(DebugView view) {
+		return view == DebugView::termination ? DebugView::radiance : (DebugView)((int)view + 1);
+	}
+};
@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Asynchronous texture and buffer readback through a ring of persistently mapped pixel buffers. A read only
+// queues the copy and a fence; Poll() hands finished copies to their callbacks, in the order they
+// were queued, without ever waiting on the GPU. The mapped data stays valid until Release(), which may come from any thread, so
+// consumers can keep working on it off the render thread.
+class ReadbackRing {
+public:
+	// Runs on the render thread inside Poll(). slot must be passed to Release() once data is no longer needed.
+	typedef std::function<void(unsigned int slot, const void* data, size_t size)> Callback;
+public:
+	ReadbackRing(unsigned int slotCount = 3) {
+		for (unsigned int i = 0; i < slotCount; i++) slots.emplace_back(new Slot());
+	}
+	~ReadbackRing() {
+		for (std::unique_ptr<Slot>& slot : slots) {
+			if (slot->fence) glDeleteSync(slot->fence);
+			DeleteBuffer(*slot);
+		}
+	}
+	ReadbackRing(const ReadbackRing&) = delete;
+	ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+	// Queues a copy of level 0 of texture. False when every slot is still in flight or held by a
+	// consumer; the caller decides whether to skip this read or try again later.
+	bool ReadTexture(GLuint texture, GLenum format, GLenum type, size_t size, Callback callback) {
+		Slot* slot = AcquireSlot(size);
+		if (!slot) return false;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glGetTextureImage(texture, 0, format, type, (GLsizei)size, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		Submit(*slot, size, callback);
+		return true;
+	}
+	// Queues a copy of the first size bytes of buffer, delivered like ReadTexture().
+	bool ReadBuffer(GLuint buffer, size_t size, Callback callback) {
+		Slot* slot = AcquireSlot(size);
+		if (!slot) return false;
+
+		glCopyNamedBufferSubData(buffer, slot->buffer, 0, 0, size);
+
+		Submit(*slot, size, callback);
+		return true;
+	}
+	// Delivers every finished copy, oldest first; a copy that is done waits for the ones queued before it.
+	// Never blocks.
+	void Poll() {
+		while (true) {
+			unsigned int i = GetOldestInFlight();
+			if (i == slots.size()) return;
+			Slot& slot = *slots[i];
+			if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+			slot.state.store(HELD);
+
+			Callback callback = slot.callback;
+			slot.callback = nullptr;
+			callback(i, slot.mapped, slot.size);
+		}
+	}
+	void Release(unsigned int slot) {
+		slots[slot]->state.store(FREE);
+	}
+	// Delivers everything in flight and waits until consumers have released it all. Render thread only.
+	void Finish() {
+		while (true) {
+			bool idle = true;
+			for (std::unique_ptr<Slot>& slot : slots) {
+				if (slot->state.load() == IN_FLIGHT) glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				idle &= slot->state.load() == FREE;
+			}
+			Poll();
+			if (idle) return;
+			std::this_thread::yield();
+		}
+	}
+	unsigned int GetSlotCount() {
+		return (unsigned int)slots.size();
+	}
+	unsigned int GetBusyCount() {
+		unsigned int busy = 0;
+		for (std::unique_ptr<Slot>& slot : slots) busy += slot->state.load() != FREE;
+		return busy;
+	}
+private:
+	enum State {
+		FREE,
+		IN_FLIGHT,
+		HELD
+	};
+	struct Slot {
+		GLuint buffer = 0;
+		size_t capacity = 0, size = 0;
+		void* mapped = nullptr;
+		GLsync fence = nullptr;
+		uint64_t sequence = 0;
+		Callback callback;
+		std::atomic<int> state{ FREE };
+	};
+
+	// A free slot with room for size bytes, or nullptr.
+	Slot* AcquireSlot(size_t size) {
+		Slot* slot = nullptr;
+		for (std::unique_ptr<Slot>& candidate : slots) {
+			if (candidate->state.load() == FREE) {
+				slot = candidate.get();
+				break;
+			}
+		}
+		if (!slot) return nullptr;
+
+		if (slot->capacity < size) {
+			DeleteBuffer(*slot);
+			glCreateBuffers(1, &slot->buffer);
+			GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glNamedBufferStorage(slot->buffer, size, nullptr, flags);
+			slot->mapped = glMapNamedBufferRange(slot->buffer, 0, size, flags);
+			slot->capacity = size;
+		}
+		return slot;
+	}
+	// Fences the copy just queued into slot.
+	void Submit(Slot& slot, size_t size, Callback callback) {
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.sequence = nextSequence++;
+		slot.size = size;
+		slot.callback = callback;
+		slot.state.store(IN_FLIGHT);
+		// Make sure the copy is submitted, or the fence might never signal without a later flush.
+		glFlush();
+	}
+	// Index of the in-flight slot queued first, or the slot count if none is in flight.
+	unsigned int GetOldestInFlight() {
+		unsigned int oldest = (unsigned int)slots.size();
+		for (unsigned int i = 0; i < slots.size(); i++) {
+			if (slots[i]->state.load() != IN_FLIGHT) continue;
+			if (oldest == slots.size() || slots[i]->sequence < slots[oldest]->sequence) oldest = i;
+		}
+		return oldest;
+	}
+	static void DeleteBuffer(Slot& slot) {
+		if (!slot.buffer) return;
+		glUnmapNamedBuffer(slot.buffer);
+		glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+		slot.capacity = 0;
+		slot.mapped = nullptr;
+	}
+private:
+	std::vector<std::unique_ptr<Slot>> slots;
+	uint64_t nextSequence = 0;
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_MSC_VER)
+#include <io.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "SceneDescription.h"
+#include "AccumulationFile.h"
+#include "Image.h"
+
+// Splits the samples of one frame over any number of worker processes that share a job directory:
+//
+//	job.txt            sample count and chunk size
+//	scene.txt          snapshot of the scene every worker renders
+//	chunk_<n>.claim    created exclusively by the worker that takes chunk n
+//	chunk_<n>.acc      raw sums and counts of chunk n, see AccumulationFile
+//
+// Chunk n covers sample indices [n * chunkSize, (n + 1) * chunkSize), so every worker draws from
+// its own RNG streams and the merged image is exactly the image one process would have accumulated.
+// Deleting a claim without a matching .acc hands a chunk of a crashed worker to the next one.
+class RenderFarm {
+public:
+	RenderFarm(const std::string& jobDirectory) {
+		this->jobDirectory = jobDirectory;
+	}
+	bool CreateJob(SceneDescription& scene, unsigned int sampleCount, unsigned int chunkSize) {
+		if (sampleCount == 0 || chunkSize == 0) {
+			std::cout << "ERROR: Render farm jobs need at least one sample and one sample per chunk" << std::endl;
+			return false;
+		}
+		MakeDirectory(jobDirectory);
+		if (!scene.Save(GetPath("scene.txt"))) return false;
+
+		std::ofstream file = std::ofstream(GetPath("job.txt"));
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not create render farm job in <" << jobDirectory << ">" << std::endl;
+			return false;
+		}
+		file << "samples " << sampleCount << "\n" << "chunk " << chunkSize << "\n";
+		this->sampleCount = sampleCount;
+		this->chunkSize = chunkSize;
+		return !file.fail();
+	}
+	bool LoadJob() {
+		std::ifstream file = std::ifstream(GetPath("job.txt"));
+		if (!file.is_open()) {
+			std::cout << "ERROR: No render farm job in <" << jobDirectory << ">" << std::endl;
+			return false;
+		}
+		std::string key;
+		while (file >> key) {
+			if (key == "samples") file >> sampleCount;
+			else if (key == "chunk") file >> chunkSize;
+		}
+		if (sampleCount == 0 || chunkSize == 0) {
+			std::cout << "ERROR: Malformed render farm job in <" << jobDirectory << ">" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	SceneDescription LoadScene() {
+		return SceneDescription(GetPath("scene.txt"));
+	}
+	// Takes the first chunk nobody has claimed yet. False once every chunk is taken.
+	bool ClaimChunk(unsigned int& chunk) {
+		for (unsigned int i = 0; i < GetChunkCount(); i++) {
+			if (CreateExclusive(GetPath("chunk_" + std::to_string(i) + ".claim"))) {
+				chunk = i;
+				return true;
+			}
+		}
+		return false;
+	}
+	unsigned int GetChunkOffset(unsigned int chunk) {
+		return chunk * chunkSize;
+	}
+	unsigned int GetChunkSampleCount(unsigned int chunk) {
+		return std::min(chunkSize, sampleCount - chunk * chunkSize);
+	}
+	unsigned int GetChunkCount() {
+		return (sampleCount + chunkSize - 1) / chunkSize;
+	}
+	bool WriteChunk(unsigned int chunk, const AccumulationFile& accumulation) {
+		return accumulation.Write(GetChunkPath(chunk));
+	}
+	// Sums every finished chunk and divides by the total sample count per pixel. Chunks are added in
+	// index order in double precision, so the result does not depend on which worker finished first.
+	bool Merge(Image& image, unsigned int& mergedSamples) {
+		std::vector<double> sums;
+		unsigned int width = 0, height = 0;
+		mergedSamples = 0;
+
+		for (unsigned int i = 0; i < GetChunkCount(); i++) {
+			AccumulationFile chunk;
+			if (!chunk.Read(GetChunkPath(i))) {
+				std::cout << "WARNING: Chunk " << i << " has not been rendered yet" << std::endl;
+				continue;
+			}
+			if (sums.empty()) {
+				width = chunk.width;
+				height = chunk.height;
+				sums.resize(chunk.pixels.size(), 0.0);
+			}
+			if (chunk.width != width || chunk.height != height) {
+				std::cout << "ERROR: Chunk " << i << " is " << chunk.width << "x" << chunk.height
+					<< ", expected " << width << "x" << height << std::endl;
+				return false;
+			}
+			for (size_t p = 0; p < sums.size(); p++) sums[p] += chunk.pixels[p];
+			mergedSamples += chunk.sampleCount;
+		}
+		if (sums.empty()) {
+			std::cout << "ERROR: No finished chunks in <" << jobDirectory << ">" << std::endl;
+			return false;
+		}
+
+		image = Image(width, height);
+		for (size_t i = 0; i < (size_t)width * height; i++) {
+			double count = sums[i * 4 + 3];
+			for (int c = 0; c < 3; c++) image.pixels[i * 3 + c] = count > 0.0 ? (float)(sums[i * 4 + c] / count) : 0.0f;
+		}
+		return true;
+	}
+	unsigned int GetSampleCount() {
+		return sampleCount;
+	}
+private:
+	std::string jobDirectory;
+	unsigned int sampleCount = 0;
+	unsigned int chunkSize = 0;
+private:
+	std::string GetPath(const std::string& name) {
+		return jobDirectory + "/" + name;
+	}
+	std::string GetChunkPath(unsigned int chunk) {
+		return GetPath("chunk_" + std::to_string(chunk) + ".acc");
+	}
+	// Atomic on local file systems, which is what makes the claims safe between processes.
+	static bool CreateExclusive(const std::string& path) {
+#if defined(_MSC_VER)
+		int descriptor = _open(path.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY, _S_IREAD | _S_IWRITE);
+		if (descriptor < 0) return false;
+		_close(descriptor);
+#else
+		int descriptor = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+		if (descriptor < 0) return false;
+		close(descriptor);
+#endif
+		return true;
+	}
+	static void MakeDirectory(const std::string& path) {
+#if defined(_MSC_VER)
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+};
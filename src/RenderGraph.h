@@ -0,0 +1,304 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Texture.h"
+#include "RenderTargetPool.h"
+#include "Profiler.h"
+
+// How a pass touches a resource. Each access maps to the glMemoryBarrier() bit that makes
+// earlier incoherent writes (image stores, SSBO writes, atomic counters) visible to it.
+enum class Access {
+	ImageLoad,
+	ImageStore,
+	Sample,
+	StorageRead,
+	StorageWrite,
+	AtomicCounter,
+	Uniform,
+	Framebuffer,
+	TextureTransfer,
+	BufferTransfer
+};
+
+typedef unsigned int ResourceHandle;
+
+class RenderGraph {
+public:
+	class Pass {
+		friend class RenderGraph;
+	public:
+		Pass& Read(ResourceHandle resource, Access access) {
+			uses.push_back(Use{ resource, access, false });
+			return *this;
+		}
+		Pass& Write(ResourceHandle resource, Access access) {
+			uses.push_back(Use{ resource, access, true });
+			return *this;
+		}
+		// Disabled passes are skipped and no longer keep their inputs alive. Only culling is redone,
+		// so passes can be toggled every frame without recompiling the graph.
+		Pass& SetEnabled(bool enabled) {
+			if (this->enabled != enabled) graph->cullingValid = false;
+			this->enabled = enabled;
+			return *this;
+		}
+		bool IsEnabled() {
+			return enabled;
+		}
+		const std::string& GetName() {
+			return name;
+		}
+		bool IsCulled() {
+			return culled;
+		}
+	private:
+		struct Use {
+			ResourceHandle resource;
+			Access access;
+			bool write;
+		};
+		RenderGraph* graph;
+		std::string name;
+		// name for profiler zones, which outlive the graph.
+		const char* profileName;
+		std::function<void(RenderGraph&)> execute;
+		std::vector<Use> uses;
+		bool enabled = true;
+		bool culled = false;
+	};
+public:
+	// Transient targets come from renderTargets, which must outlive the graph.
+	RenderGraph(RenderTargetPool& renderTargets) : renderTargets(renderTargets) {}
+	~RenderGraph() {
+		for (PhysicalTexture& physical : physicalTextures) renderTargets.Release(std::move(physical.texture));
+	}
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	ResourceHandle ImportTexture(const std::string& name, Texture* texture) {
+		return AddResource(name, texture, 0, 0, 0, true);
+	}
+	// Points an imported texture at another, e.g. once an asset has finished loading in the background.
+	void ReplaceImport(ResourceHandle resource, Texture* texture) {
+		resources[resource].texture = texture;
+	}
+	ResourceHandle ImportBuffer(const std::string& name) {
+		return AddResource(name, nullptr, 0, 0, 0, true);
+	}
+	ResourceHandle ImportBackbuffer() {
+		return AddResource("Backbuffer", nullptr, 0, 0, 0, true);
+	}
+	// Transient targets live only between their first and last use in a frame and may share
+	// storage with other transients of the same size and format.
+	ResourceHandle CreateTexture(const std::string& name, unsigned int width, unsigned int height, GLenum internalFormat) {
+		return AddResource(name, nullptr, width, height, internalFormat, false);
+	}
+	// E.g. on a window resize; the transient gets storage of the new size on the next Compile().
+	void ResizeTexture(ResourceHandle resource, unsigned int width, unsigned int height) {
+		resources[resource].width = width;
+		resources[resource].height = height;
+		compiled = false;
+	}
+	Pass& AddPass(const std::string& name, std::function<void(RenderGraph&)> execute) {
+		passes.emplace_back(new Pass());
+		passes.back()->graph = this;
+		passes.back()->name = name;
+		passes.back()->profileName = Profiler::Get().Intern(name);
+		passes.back()->execute = execute;
+		compiled = false;
+		return *passes.back();
+	}
+	Texture& GetTexture(ResourceHandle resource) {
+		Texture* texture = resources[resource].texture;
+		if (!texture) texture = physicalTextures[resources[resource].physical].texture.get();
+		return *texture;
+	}
+	void Compile() {
+		AliasTransients();
+		compiled = true;
+		cullingValid = false;
+	}
+	void Execute() {
+		if (!compiled) Compile();
+		if (!cullingValid) CullPasses();
+
+		for (std::unique_ptr<Pass>& pass : passes) {
+			if (pass->culled) continue;
+			AcquireTransients(*pass);
+
+			GLbitfield barrierBits = 0;
+			for (const Pass::Use& use : pass->uses) barrierBits |= pendingBits[PhysicalIndex(use.resource)] & GetBarrierBit(use.access);
+
+			if (barrierBits) {
+				glMemoryBarrier(barrierBits);
+				// A barrier is global, so it covers every resource with pending writes of those kinds.
+				for (GLbitfield& pending : pendingBits) pending &= ~barrierBits;
+			}
+			PROFILE_ZONE(pass->profileName);
+			PROFILE_GPU_ZONE(pass->profileName);
+			pass->execute(*this);
+
+			for (const Pass::Use& use : pass->uses) {
+				if (use.write && IsIncoherent(use.access)) pendingBits[PhysicalIndex(use.resource)] = ALL_BARRIER_BITS;
+			}
+		}
+	}
+	void PrintPlan() {
+		if (!compiled) Compile();
+		if (!cullingValid) CullPasses();
+
+		for (std::unique_ptr<Pass>& pass : passes) {
+			std::cout << (pass->culled ? "  [culled] " : "  ") << pass->name << std::endl;
+		}
+		for (Resource& resource : resources) {
+			if (resource.imported || resource.firstUse < 0) continue;
+			std::cout << "  " << resource.name << " -> transient target " << resource.physical << std::endl;
+		}
+	}
+private:
+	struct Resource {
+		std::string name;
+		Texture* texture;
+		unsigned int width, height;
+		GLenum internalFormat;
+		bool imported;
+
+		int firstUse, lastUse;
+		unsigned int physical;
+	};
+	struct PhysicalTexture {
+		std::unique_ptr<Texture> texture;
+		int lastUse;
+	};
+	static const GLbitfield ALL_BARRIER_BITS =
+		GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+		GL_ATOMIC_COUNTER_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT |
+		GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT;
+
+	RenderTargetPool& renderTargets;
+	std::vector<Resource> resources;
+	std::vector<std::unique_ptr<Pass>> passes;
+	std::vector<PhysicalTexture> physicalTextures;
+	// The first resource assigned to each physical texture, whose size and format it has.
+	std::vector<unsigned int> physicalResources;
+	// Barrier bits still owed by each physical resource (imported resources first, then pooled transients).
+	std::vector<GLbitfield> pendingBits;
+
+	bool compiled = false;
+	bool cullingValid = false;
+private:
+	ResourceHandle AddResource(const std::string& name, Texture* texture, unsigned int width, unsigned int height, GLenum internalFormat, bool imported) {
+		resources.push_back(Resource{ name, texture, width, height, internalFormat, imported, -1, -1, 0 });
+		compiled = false;
+		return (ResourceHandle)resources.size() - 1;
+	}
+	unsigned int PhysicalIndex(ResourceHandle resource) {
+		return resources[resource].imported ? resource : (unsigned int)resources.size() + resources[resource].physical;
+	}
+	static bool IsIncoherent(Access access) {
+		return access == Access::ImageStore || access == Access::StorageWrite || access == Access::AtomicCounter;
+	}
+	static GLbitfield GetBarrierBit(Access access) {
+		switch (access) {
+		case Access::ImageLoad:
+		case Access::ImageStore:      return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+		case Access::Sample:          return GL_TEXTURE_FETCH_BARRIER_BIT;
+		case Access::StorageRead:
+		case Access::StorageWrite:    return GL_SHADER_STORAGE_BARRIER_BIT;
+		case Access::AtomicCounter:   return GL_ATOMIC_COUNTER_BARRIER_BIT;
+		case Access::Uniform:         return GL_UNIFORM_BARRIER_BIT;
+		case Access::Framebuffer:     return GL_FRAMEBUFFER_BARRIER_BIT;
+		case Access::TextureTransfer: return GL_TEXTURE_UPDATE_BARRIER_BIT;
+		case Access::BufferTransfer:  return GL_BUFFER_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT;
+		}
+		return 0;
+	}
+	// Walk the passes backwards: an enabled pass survives if it writes an imported resource or
+	// something a surviving later pass reads.
+	void CullPasses() {
+		cullingValid = true;
+		std::vector<bool> needed = std::vector<bool>(resources.size(), false);
+		for (unsigned int i = 0; i < resources.size(); i++) needed[i] = resources[i].imported;
+
+		for (int i = (int)passes.size() - 1; i >= 0; i--) {
+			Pass& pass = *passes[i];
+			pass.culled = true;
+			if (!pass.enabled) continue;
+			for (const Pass::Use& use : pass.uses) {
+				if (use.write && needed[use.resource]) pass.culled = false;
+			}
+			if (pass.culled) continue;
+			for (const Pass::Use& use : pass.uses) {
+				if (!use.write) needed[use.resource] = true;
+			}
+		}
+	}
+	// Lifetimes span every pass, enabled or not, so the assignment holds for whichever passes survive
+	// culling. Storage is only acquired once a pass using it runs; see AcquireTransients().
+	void AliasTransients() {
+		for (Resource& resource : resources) resource.firstUse = resource.lastUse = -1;
+
+		for (int i = 0; i < (int)passes.size(); i++) {
+			for (const Pass::Use& use : passes[i]->uses) {
+				Resource& resource = resources[use.resource];
+				if (resource.firstUse < 0) resource.firstUse = i;
+				resource.lastUse = i;
+			}
+		}
+		// Everything goes back to the pool and is handed out again, so unchanged targets keep their
+		// storage and resized ones are swapped for targets of the new size.
+		for (PhysicalTexture& physical : physicalTextures) renderTargets.Release(std::move(physical.texture));
+		physicalTextures.clear();
+		physicalResources.clear();
+
+		std::vector<unsigned int> order;
+		for (unsigned int i = 0; i < resources.size(); i++) {
+			if (!resources[i].imported && resources[i].firstUse >= 0) order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return resources[a].firstUse < resources[b].firstUse; });
+
+		for (unsigned int index : order) {
+			Resource& resource = resources[index];
+
+			int match = -1;
+			for (unsigned int i = 0; i < physicalTextures.size(); i++) {
+				Resource& first = resources[physicalResources[i]];
+				if (first.width != resource.width || first.height != resource.height || first.internalFormat != resource.internalFormat) continue;
+				if (physicalTextures[i].lastUse < resource.firstUse) {
+					match = i;
+					break;
+				}
+			}
+			if (match < 0) {
+				physicalTextures.push_back(PhysicalTexture{ nullptr, -1 });
+				physicalResources.push_back(index);
+				match = (int)physicalTextures.size() - 1;
+			}
+			physicalTextures[match].lastUse = resource.lastUse;
+			resource.physical = match;
+		}
+		// Transients may have moved to other storage, so their first use waits for any write.
+		pendingBits.resize(resources.size());
+		pendingBits.resize(resources.size() + physicalTextures.size(), (GLbitfield)ALL_BARRIER_BITS);
+	}
+	// Transients only read back now and then get storage the first time they are used and keep it
+	// until the next Compile(), so neither toggling their passes nor a readback allocates.
+	void AcquireTransients(Pass& pass) {
+		for (const Pass::Use& use : pass.uses) {
+			Resource& resource = resources[use.resource];
+			if (resource.imported) continue;
+			PhysicalTexture& physical = physicalTextures[resource.physical];
+			if (physical.texture) continue;
+			physical.texture = renderTargets.Acquire(resource.width, resource.height, resource.internalFormat);
+			// Its last writer may have been anything that used the pool since the last barrier.
+			pendingBits[PhysicalIndex(use.resource)] = ALL_BARRIER_BITS;
+		}
+	}
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+enum class RenderMode {
+	interactive,
+	offline
+};
+enum class EnvironmentFormat {
+	// Full precision, 12 bytes per texel, converted on every load.
+	rgb32f,
+	// BC6H from a cache file next to the source, 1 byte per texel.
+	bc6h
+};
+
+// The one storage difference between the modes. Every render target is RGBA32F either way, so a still
+// interactive camera converges like an offline render and readbacks see it.
+inline EnvironmentFormat GetEnvironmentFormat(RenderMode renderMode) {
+	return renderMode == RenderMode::interactive ? EnvironmentFormat::bc6h : EnvironmentFormat::rgb32f;
+}
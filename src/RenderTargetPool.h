@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <glad/glad.h>
+
+#include "Texture.h"
+
+// Render targets released for reuse. Acquire() hands back a released target of the same size and
+// format before allocating a new one, so recompiling the render graph or resizing back and forth
+// costs no allocations. Released targets not reused within MAX_IDLE_FRAMES calls to NextFrame() are
+// deleted, which frees the sizes a window has been dragged through without holding them forever.
+class RenderTargetPool {
+public:
+	static const unsigned int MAX_IDLE_FRAMES = 60;
+public:
+	RenderTargetPool() {}
+	RenderTargetPool(const RenderTargetPool&) = delete;
+	RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+	std::unique_ptr<Texture> Acquire(unsigned int width, unsigned int height, GLenum internalFormat) {
+		for (size_t i = 0; i < released.size(); i++) {
+			Texture& texture = *released[i].texture;
+			if (texture.GetWidth() != width || texture.GetHeight() != height || texture.GetFormat() != internalFormat) continue;
+			std::unique_ptr<Texture> reused = std::move(released[i].texture);
+			released.erase(released.begin() + i);
+			return reused;
+		}
+		allocationCount++;
+		return std::unique_ptr<Texture>(new Texture(width, height, internalFormat));
+	}
+	// The target may still be in use by queued GPU work; GL orders later writes after it.
+	void Release(std::unique_ptr<Texture> texture) {
+		if (texture) released.push_back(Released{ std::move(texture), 0 });
+	}
+	void NextFrame() {
+		for (size_t i = 0; i < released.size();) {
+			if (++released[i].idleFrames > MAX_IDLE_FRAMES) released.erase(released.begin() + i);
+			else i++;
+		}
+	}
+	// Deletes every released target.
+	void Clear() {
+		released.clear();
+	}
+	size_t GetReleasedCount() {
+		return released.size();
+	}
+	// Targets created since construction, i.e. requests the pool could not serve.
+	unsigned int GetAllocationCount() {
+		return allocationCount;
+	}
+private:
+	struct Released {
+		std::unique_ptr<Texture> texture;
+		unsigned int idleFrames;
+	};
+	std::vector<Released> released;
+	unsigned int allocationCount = 0;
+};
@@ -0,0 +1,578 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+#include "Mesh.h"
+#include "Primitives.h"
+#include "Texture.h"
+#include "Camera.h"
+#include "Volume.h"
+#include "RenderGraph.h"
+#include "RenderMode.h"
+#include "Image.h"
+#include "CpuRenderer.h"
+#include "HybridController.h"
+#include "ReadbackRing.h"
+#include "AccumulationFile.h"
+#include "RayStatistics.h"
+#include "AssetLoader.h"
+
+// Owns the GPU pipeline: accumulation target, shaders and the render graph that schedules them.
+// Given a CpuRenderer it runs in hybrid mode, where the CPU renders part of every sample alongside
+// the GPU and its results are folded into the same accumulation target. Given an AssetLoader it
+// renders with a uniform sky until the environment map has loaded in the background. Every size
+// dependent target comes from a RenderTargetPool, so Resize() follows the window without leaking
+// or waiting on the GPU.
+class Renderer {
+public:
+	// Radiance of the uniform sky shown while the environment map loads.
+	static constexpr float PLACEHOLDER_SKY_RADIANCE = 0.5f;
+public:
+	Renderer(unsigned int width, unsigned int height, RenderMode renderMode, const std::string& environmentMapPath, CpuRenderer* cpuRenderer = nullptr,
+		AssetLoader* assetLoader = nullptr) :
+		renderTargets(),
+		quad(QUAD_VERTS, QUAD_INDICES),
+		postProcessShader("src/Shaders/NDC.vert", "src/Shaders/PostProcess.frag"),
+		renderShader("src/Shaders/Render.comp"),
+		resolveShader("src/Shaders/Resolve.comp"),
+		tonemapShader("src/Shaders/Tonemap.comp"),
+		cumulativeRenderTexture(renderTargets.Acquire(width, height, GL_RGBA32F)),
+		renderGraph(renderTargets)
+	{
+		this->width = width;
+		this->height = height;
+
+		BindCumulativeRenderTexture();
+
+		// Without an environment map path the placeholder sky stays.
+		if (environmentMapPath.empty()) environmentMap = AssetLoader::CreatePlaceholderEnvironmentMap(glm::vec3(PLACEHOLDER_SKY_RADIANCE));
+		else if (assetLoader) {
+			environmentMap = AssetLoader::CreatePlaceholderEnvironmentMap(glm::vec3(PLACEHOLDER_SKY_RADIANCE));
+			assetLoader->LoadEnvironmentMap(environmentMapPath, GetEnvironmentFormat(renderMode), [this](std::unique_ptr<Texture> texture) { SetEnvironmentMap(std::move(texture)); });
+		}
+		else environmentMap.reset(new Texture(environmentMapPath, GetEnvironmentFormat(renderMode)));
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, environmentMap->GetID());
+
+		postProcessShader.SetInt("cumulativeRenderTexture", 0);
+		renderShader.SetInt("environmentMap", 1);
+		SetCropWindow(0, 0, width, height);
+
+		GLuint buffer;
+		glCreateBuffers(1, &buffer);
+		rayStatisticsBuffer.Reset(buffer);
+		glNamedBufferStorage(buffer, RayStatistics::COUNTER_COUNT * sizeof(uint64_t), nullptr, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffer);
+
+		this->cpuRenderer = cpuRenderer;
+		if (cpuRenderer) {
+			mergeShader.reset(new ShaderProgram("src/Shaders/Render.comp", std::vector<std::string>{ "MERGE_EXTERNAL_SAMPLES" }));
+			cpuSampleTexture = renderTargets.Acquire(width, height, GL_RGBA32F);
+			GLuint query;
+			glGenQueries(1, &query);
+			gpuTimerQuery.Reset(query);
+		}
+		BuildRenderGraph();
+	}
+	~Renderer() {
+		// GPU zones refer to queries of this context.
+		Profiler::Get().FinishGpuZones();
+	}
+	void SetVolume(Volume& volume) {
+		renderShader.SetVec3("volume.cornerMin", volume.cornerMin);
+		renderShader.SetVec3("volume.cornerMax", volume.cornerMax);
+		renderShader.SetVec3("volume.center", (volume.cornerMin + volume.cornerMax) / 2.0f);
+		renderShader.SetFloat("_StepCount", volume.stepCount);
+		stepCount = volume.stepCount;
+		UpdateHeatmapScale();
+		if (cpuRenderer) cpuRenderer->SetVolume(volume);
+	}
+	// Restarts accumulation whenever the camera has moved since the last call.
+	void SetCamera(Camera& camera) {
+		if (lastCameraModelMatrix != camera.GetModelMatrix()) {
+			ResetAccumulation();
+			lastCameraModelMatrix = camera.GetModelMatrix();
+		}
+		renderShader.SetVec3("camera.pos", camera.GetPosition());
+
+		renderShader.SetVec3("camera.xAxis", camera.GetXAxis());
+		renderShader.SetVec3("camera.yAxis", camera.GetYAxis());
+		renderShader.SetVec3("camera.zAxis", camera.GetZAxis());
+
+		renderShader.SetFloat("camera.focalLength", camera.GetFocalLength());
+		if (cpuRenderer) cpuRenderer->SetCamera(camera);
+	}
+	void ResetAccumulation() {
+		sampleNum = 1.0f;
+	}
+	// Reallocates the accumulation, CPU sample and transient targets at the new size, e.g. when the
+	// window is resized, and renders the whole new image from scratch. The old targets go back to the
+	// pool, so work still queued on them needs no wait. Readbacks requested before keep the old size.
+	void Resize(unsigned int width, unsigned int height) {
+		if (width == this->width && height == this->height) return;
+		PROFILE_ZONE("Resize render targets");
+		this->width = width;
+		this->height = height;
+
+		renderTargets.Release(std::move(cumulativeRenderTexture));
+		cumulativeRenderTexture = renderTargets.Acquire(width, height, GL_RGBA32F);
+		BindCumulativeRenderTexture();
+		renderGraph.ReplaceImport(cumulativeResource, cumulativeRenderTexture.get());
+		renderGraph.ResizeTexture(linearOutputResource, width, height);
+		renderGraph.ResizeTexture(tonemappedOutputResource, width, height);
+		if (cpuRenderer) {
+			cpuRenderer->Resize(width, height);
+			renderTargets.Release(std::move(cpuSampleTexture));
+			cpuSampleTexture = renderTargets.Acquire(width, height, GL_RGBA32F);
+			renderGraph.ReplaceImport(cpuSampleResource, cpuSampleTexture.get());
+		}
+		SetCropWindow(0, 0, width, height);
+	}
+	RenderTargetPool& GetRenderTargetPool() {
+		return renderTargets;
+	}
+	// Swaps the environment map, e.g. for the real one once it has loaded. Restarts accumulation.
+	void SetEnvironmentMap(std::unique_ptr<Texture> texture) {
+		environmentMap = std::move(texture);
+		glBindTextureUnit(1, environmentMap->GetID());
+		renderGraph.ReplaceImport(environmentResource, environmentMap.get());
+		ResetAccumulation();
+	}
+	// Renders the window of a larger imageWidth x imageHeight image whose bottom left pixel is at
+	// (x, y). The window may reach past the image edges. The camera must be set up for the whole image.
+	void SetCropWindow(int x, int y, unsigned int imageWidth, unsigned int imageHeight) {
+		renderShader.SetIVec2("_CropOffset", glm::ivec2(x, y));
+		renderShader.SetVec2("_ImageSize", glm::vec2(imageWidth, imageHeight));
+		ResetAccumulation();
+	}
+	// RNG stream of the first sample after a reset. Sample n uses stream sampleOffset + n, so
+	// renders with disjoint ranges produce independent samples of the same image.
+	void SetSampleOffset(unsigned int sampleOffset) {
+		this->sampleOffset = sampleOffset;
+	}
+	// What the march pass accumulates: radiance, or one of the per pixel cost counts, which are then
+	// presented as a heatmap. The linear output holds the raw counts. Restarts accumulation.
+	void SetDebugView(DebugView debugView) {
+		this->debugView = debugView;
+		renderShader.SetInt("_DebugView", (int)debugView);
+		UpdateHeatmapScale();
+		UpdateCostCounting();
+		ResetAccumulation();
+	}
+	DebugView GetDebugView() {
+		return debugView;
+	}
+	// The count the debug view presents as white, 0 for radiance.
+	float GetHeatmapScale() {
+		return heatmapScale;
+	}
+	// Counts what every sample's rays cost into GetRayStatistics(). The counters are read back
+	// asynchronously, so the totals trail the samples rendered by a frame or two.
+	void SetCollectingRayStatistics(bool collecting) {
+		collectingRayStatistics = collecting;
+		renderShader.SetInt("_CollectStatistics", collecting);
+		clearRayStatisticsPass->SetEnabled(collecting);
+		rayStatisticsReadbackPass->SetEnabled(collecting);
+		UpdateCostCounting();
+	}
+	const RayStatistics& GetRayStatistics() {
+		return rayStatistics;
+	}
+	void ResetRayStatistics() {
+		rayStatistics = RayStatistics();
+	}
+	// Tonemap into the bound framebuffer after every sample. Off for headless rendering.
+	void SetPresenting(bool presenting) {
+		tonemapPass->SetEnabled(presenting);
+	}
+	void Render(float time) {
+		PROFILE_ZONE("Renderer::Render");
+		renderTargets.NextFrame();
+		{
+			PROFILE_ZONE("Poll readbacks");
+			readbackRing.Poll();
+			statisticsRing.Poll();
+		}
+		{
+			PROFILE_ZONE("Upload uniforms");
+			renderShader.SetFloat("_Time", time);
+			renderShader.SetFloat("_SampleNum", sampleNum);
+			renderShader.SetUnsignedInt("_SampleIndex", GetSampleIndex());
+
+			splitRow = height;
+			if (cpuRenderer && cpuMarchPass->IsEnabled()) {
+				UpdateHybridSplit();
+				splitRow = hybridController.GetSplitRow(height, CpuRenderer::TILE_SIZE);
+				mergeShader->SetFloat("_SampleNum", sampleNum);
+				mergeShader->SetIVec2("_PixelOffset", glm::ivec2(0, splitRow));
+			}
+		}
+		renderGraph.Execute();
+
+		sampleNum++;
+	}
+	// Normalized linear radiance, bottom row first.
+	Image ReadLinearOutput() {
+		ExecuteReadback(readbackPass);
+		return readbackImage;
+	}
+	// The accumulation target as stored: RGBA per pixel, bottom row first, rgb running sum and alpha
+	// sample count.
+	std::vector<float> ReadAccumulation() {
+		ExecuteReadback(accumulationReadbackPass);
+		return accumulationReadback;
+	}
+	// Same layout as ReadAccumulation(), without waiting for the GPU: onReady gets the RGBA floats
+	// during a later Render() or FinishReadbacks() and must release the slot on the readback ring.
+	// False when every readback slot is busy.
+	bool ReadAccumulationAsync(ReadbackRing::Callback onReady) {
+		return ExecuteAsyncReadback(asyncReadbackPass, readbackRing, onReady);
+	}
+	// Same layout as ReadLinearOutput(), delivered like ReadAccumulationAsync().
+	bool ReadLinearOutputAsync(ReadbackRing::Callback onReady) {
+		return ExecuteAsyncReadback(asyncLinearReadbackPass, readbackRing, onReady);
+	}
+	// The presented image as 8 bit sRGB RGBA, bottom row first, through a ring the caller owns and polls.
+	bool ReadTonemappedAsync(ReadbackRing& ring, ReadbackRing::Callback onReady) {
+		return ExecuteAsyncReadback(asyncTonemappedReadbackPass, ring, onReady);
+	}
+	// Delivers every asynchronous readback and waits until their consumers are done with them.
+	void FinishReadbacks() {
+		readbackRing.Finish();
+		statisticsRing.Finish();
+	}
+	ReadbackRing& GetReadbackRing() {
+		return readbackRing;
+	}
+	// Continues the accumulation stored in accumulation (running sums) with the next sample index.
+	// Call after SetCamera(), which would otherwise reset it.
+	bool RestoreAccumulation(const AccumulationFile& accumulation) {
+		if (accumulation.width != width || accumulation.height != height) {
+			std::cout << "ERROR: Accumulation is " << accumulation.width << "x" << accumulation.height
+				<< ", the renderer " << width << "x" << height << std::endl;
+			return false;
+		}
+		glTextureSubImage2D(cumulativeRenderTexture->GetID(), 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, accumulation.pixels.data());
+
+		sampleOffset = accumulation.sampleOffset;
+		sampleNum = (float)accumulation.sampleCount + 1.0f;
+		return true;
+	}
+	unsigned int GetSampleCount() {
+		return (unsigned int)sampleNum - 1;
+	}
+	unsigned int GetSampleOffset() {
+		return sampleOffset;
+	}
+	unsigned int GetWidth() {
+		return width;
+	}
+	unsigned int GetHeight() {
+		return height;
+	}
+	bool IsHybrid() {
+		return cpuRenderer != nullptr;
+	}
+	// False in hybrid mode while a debug view or ray statistics keep the CPU out.
+	bool IsSharingWithCpu() {
+		return cpuRenderer && cpuMarchPass->IsEnabled();
+	}
+	HybridController& GetHybridController() {
+		return hybridController;
+	}
+private:
+	unsigned int width, height;
+	// Declared before every member holding its targets, so it outlives them.
+	RenderTargetPool renderTargets;
+
+	Mesh quad;
+	ShaderProgram postProcessShader;
+	ShaderProgram renderShader;
+	ShaderProgram resolveShader;
+	ShaderProgram tonemapShader;
+
+	std::unique_ptr<Texture> cumulativeRenderTexture;
+	std::unique_ptr<Texture> environmentMap;
+	ResourceHandle cumulativeResource;
+	ResourceHandle environmentResource;
+	ResourceHandle linearOutputResource;
+	ResourceHandle tonemappedOutputResource;
+
+	// Hybrid mode: the GPU marches rows [0, splitRow) and the CPU the rest.
+	CpuRenderer* cpuRenderer;
+	std::unique_ptr<ShaderProgram> mergeShader;
+	std::unique_ptr<Texture> cpuSampleTexture;
+	ResourceHandle cpuSampleResource;
+	HybridController hybridController;
+	unsigned int splitRow;
+	QueryObject gpuTimerQuery;
+	bool gpuTimerPending = false;
+	unsigned int measuredGpuRows = 0, measuredCpuRows = 0;
+	double measuredCpuSeconds = 0.0, measuredSubmitSeconds = 0.0;
+
+	RenderGraph renderGraph;
+	// Passes that add a sample, skipped when only reading the accumulation back.
+	std::vector<RenderGraph::Pass*> samplePasses;
+	RenderGraph::Pass* tonemapPass;
+	RenderGraph::Pass* readbackPass;
+	RenderGraph::Pass* accumulationReadbackPass;
+	RenderGraph::Pass* asyncReadbackPass;
+	RenderGraph::Pass* asyncLinearReadbackPass;
+	RenderGraph::Pass* asyncTonemappedReadbackPass;
+	RenderGraph::Pass* clearRayStatisticsPass;
+	RenderGraph::Pass* rayStatisticsReadbackPass;
+	RenderGraph::Pass* cpuMarchPass = nullptr;
+	RenderGraph::Pass* mergeCpuSamplesPass = nullptr;
+	ReadbackRing readbackRing;
+	// Where the asynchronous readback pass being executed delivers to.
+	ReadbackRing* asyncReadbackRing = nullptr;
+	ReadbackRing::Callback asyncReadbackCallback;
+	Image readbackImage;
+	std::vector<float> accumulationReadback;
+
+	DebugView debugView = DebugView::radiance;
+	bool collectingRayStatistics = false;
+	float stepCount = 0.0f, heatmapScale = 0.0f;
+	// Counters Render.comp adds every sample's totals to, cleared before each sample.
+	BufferObject rayStatisticsBuffer;
+	// Separate from readbackRing so the small counter reads never wait behind image reads.
+	ReadbackRing statisticsRing{ 4 };
+	RayStatistics rayStatistics;
+
+	float sampleNum = 1.0f;
+	unsigned int sampleOffset = 0;
+	glm::mat4 lastCameraModelMatrix = glm::mat4(0.0f);
+private:
+	void BuildRenderGraph() {
+		ResourceHandle cumulativeRender = renderGraph.ImportTexture("CumulativeRender", cumulativeRenderTexture.get());
+		environmentResource = renderGraph.ImportTexture("EnvironmentMap", environmentMap.get());
+		ResourceHandle linearOutput = renderGraph.CreateTexture("LinearOutput", width, height, GL_RGBA32F);
+		ResourceHandle tonemappedOutput = renderGraph.CreateTexture("TonemappedOutput", width, height, GL_RGBA8);
+		cumulativeResource = cumulativeRender;
+		linearOutputResource = linearOutput;
+		tonemappedOutputResource = tonemappedOutput;
+		ResourceHandle backbuffer = renderGraph.ImportBackbuffer();
+		ResourceHandle hostImage = renderGraph.ImportBuffer("HostImage");
+		ResourceHandle rayStatisticsCounters = renderGraph.ImportBuffer("RayStatistics");
+		ResourceHandle hostRayStatistics = renderGraph.ImportBuffer("HostRayStatistics");
+
+		clearRayStatisticsPass = &renderGraph.AddPass("ClearRayStatistics", [this](RenderGraph&) {
+			glClearNamedBufferData(rayStatisticsBuffer.Get(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		})
+			.Write(rayStatisticsCounters, Access::BufferTransfer)
+			.SetEnabled(false);
+		samplePasses.push_back(clearRayStatisticsPass);
+
+		samplePasses.push_back(&renderGraph.AddPass("March", [this](RenderGraph&) {
+			renderShader.Use();
+			if (!cpuRenderer) {
+				glDispatchCompute((width + 7) / 8, (splitRow + 3) / 4, 1);
+				return;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			glBeginQuery(GL_TIME_ELAPSED, gpuTimerQuery.Get());
+			glDispatchCompute((width + 7) / 8, (splitRow + 3) / 4, 1);
+			glEndQuery(GL_TIME_ELAPSED);
+			// Get the GPU going before the CPU starts on its share.
+			glFlush();
+			measuredSubmitSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		})
+			.Read(environmentResource, Access::Sample)
+			.Read(cumulativeRender, Access::ImageLoad)
+			.Write(cumulativeRender, Access::ImageStore)
+			.Write(rayStatisticsCounters, Access::StorageWrite));
+
+		if (cpuRenderer) AddHybridPasses(cumulativeRender);
+
+		// Never waits: a sample whose counters find every slot busy goes uncounted.
+		rayStatisticsReadbackPass = &renderGraph.AddPass("RayStatisticsReadback", [this](RenderGraph&) {
+			statisticsRing.ReadBuffer(rayStatisticsBuffer.Get(), RayStatistics::COUNTER_COUNT * sizeof(uint64_t), [this](unsigned int slot, const void* data, size_t) {
+				rayStatistics.Add((const uint32_t*)data);
+				statisticsRing.Release(slot);
+			});
+		})
+			.Read(rayStatisticsCounters, Access::BufferTransfer)
+			.Write(hostRayStatistics, Access::BufferTransfer)
+			.SetEnabled(false);
+		samplePasses.push_back(rayStatisticsReadbackPass);
+
+		// Normalized linear image for consumers that need it; culled while nothing reads it.
+		renderGraph.AddPass("Resolve", [this, linearOutput](RenderGraph& graph) {
+			graph.GetTexture(linearOutput).BindImageTexture(1, GL_WRITE_ONLY);
+			resolveShader.Use();
+			glDispatchCompute((width + 7) / 8, (height + 3) / 4, 1);
+		})
+			.Read(cumulativeRender, Access::ImageLoad)
+			.Write(linearOutput, Access::ImageStore);
+
+		readbackPass = &renderGraph.AddPass("Readback", [this, linearOutput](RenderGraph& graph) {
+			readbackImage = Image(width, height);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glGetTextureImage(graph.GetTexture(linearOutput).GetID(), 0, GL_RGB, GL_FLOAT,
+				(GLsizei)(readbackImage.pixels.size() * sizeof(float)), readbackImage.pixels.data());
+		})
+			.Read(linearOutput, Access::TextureTransfer)
+			.Write(hostImage, Access::BufferTransfer)
+			.SetEnabled(false);
+
+		accumulationReadbackPass = &renderGraph.AddPass("AccumulationReadback", [this](RenderGraph&) {
+			accumulationReadback.resize((size_t)width * height * 4);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glGetTextureImage(cumulativeRenderTexture->GetID(), 0, GL_RGBA, GL_FLOAT,
+				(GLsizei)(accumulationReadback.size() * sizeof(float)), accumulationReadback.data());
+		})
+			.Read(cumulativeRender, Access::TextureTransfer)
+			.Write(hostImage, Access::BufferTransfer)
+			.SetEnabled(false);
+
+		asyncReadbackPass = &renderGraph.AddPass("AsyncAccumulationReadback", [this](RenderGraph&) {
+			size_t size = (size_t)width * height * 4 * sizeof(float);
+			asyncReadbackRing->ReadTexture(cumulativeRenderTexture->GetID(), GL_RGBA, GL_FLOAT, size, asyncReadbackCallback);
+		})
+			.Read(cumulativeRender, Access::TextureTransfer)
+			.Write(hostImage, Access::BufferTransfer)
+			.SetEnabled(false);
+
+		asyncLinearReadbackPass = &renderGraph.AddPass("AsyncReadback", [this, linearOutput](RenderGraph& graph) {
+			size_t size = (size_t)width * height * 3 * sizeof(float);
+			asyncReadbackRing->ReadTexture(graph.GetTexture(linearOutput).GetID(), GL_RGB, GL_FLOAT, size, asyncReadbackCallback);
+		})
+			.Read(linearOutput, Access::TextureTransfer)
+			.Write(hostImage, Access::BufferTransfer)
+			.SetEnabled(false);
+
+		// Tonemapped 8 bit image for video; culled while nothing reads it.
+		renderGraph.AddPass("TonemapOutput", [this, tonemappedOutput](RenderGraph& graph) {
+			graph.GetTexture(tonemappedOutput).BindImageTexture(1, GL_WRITE_ONLY);
+			tonemapShader.Use();
+			glDispatchCompute((width + 7) / 8, (height + 3) / 4, 1);
+		})
+			.Read(cumulativeRender, Access::ImageLoad)
+			.Write(tonemappedOutput, Access::ImageStore);
+
+		asyncTonemappedReadbackPass = &renderGraph.AddPass("AsyncTonemappedReadback", [this, tonemappedOutput](RenderGraph& graph) {
+			size_t size = (size_t)width * height * 4;
+			asyncReadbackRing->ReadTexture(graph.GetTexture(tonemappedOutput).GetID(), GL_RGBA, GL_UNSIGNED_BYTE, size, asyncReadbackCallback);
+		})
+			.Read(tonemappedOutput, Access::TextureTransfer)
+			.Write(hostImage, Access::BufferTransfer)
+			.SetEnabled(false);
+
+		tonemapPass = &renderGraph.AddPass("Tonemap", [this](RenderGraph&) {
+			postProcessShader.Use();
+			quad.Draw();
+			ShaderProgram::Unuse();
+		})
+			.Read(cumulativeRender, Access::Sample)
+			.Write(backbuffer, Access::Framebuffer);
+
+		renderGraph.Compile();
+	}
+	// Image unit 0 for the compute passes, texture unit 0 for presenting.
+	void BindCumulativeRenderTexture() {
+		cumulativeRenderTexture->BindImageTexture(0, GL_READ_WRITE);
+		glBindTextureUnit(0, cumulativeRenderTexture->GetID());
+	}
+	// Runs only the given readback pass on the current accumulation.
+	void ExecuteReadback(RenderGraph::Pass* pass) {
+		bool presenting = tonemapPass->IsEnabled();
+		std::vector<bool> sampling;
+
+		for (RenderGraph::Pass* samplePass : samplePasses) {
+			sampling.push_back(samplePass->IsEnabled());
+			samplePass->SetEnabled(false);
+		}
+		tonemapPass->SetEnabled(false);
+		pass->SetEnabled(true);
+
+		renderGraph.Execute();
+
+		for (size_t i = 0; i < samplePasses.size(); i++) samplePasses[i]->SetEnabled(sampling[i]);
+		tonemapPass->SetEnabled(presenting);
+		pass->SetEnabled(false);
+	}
+	bool ExecuteAsyncReadback(RenderGraph::Pass* pass, ReadbackRing& ring, ReadbackRing::Callback onReady) {
+		if (ring.GetBusyCount() == ring.GetSlotCount()) return false;
+
+		asyncReadbackRing = &ring;
+		asyncReadbackCallback = onReady;
+		ExecuteReadback(pass);
+		asyncReadbackRing = nullptr;
+		asyncReadbackCallback = nullptr;
+		return true;
+	}
+	// The count a debug view shows as white: every step of the view ray, times a full shadow ray for
+	// the views that include those.
+	void UpdateHeatmapScale() {
+		float scale = 0.0f;
+		switch (debugView) {
+		case DebugView::radiance:    scale = 0.0f; break;
+		case DebugView::steps:       scale = stepCount; break;
+		case DebugView::noise:       scale = stepCount * (stepCount + 1.0f); break;
+		case DebugView::shadowSteps: scale = stepCount * stepCount; break;
+		case DebugView::termination: scale = stepCount; break;
+		}
+		heatmapScale = scale;
+		postProcessShader.SetFloat("_HeatmapScale", scale);
+		tonemapShader.SetFloat("_HeatmapScale", scale);
+	}
+	unsigned int GetSampleIndex() {
+		return sampleOffset + (unsigned int)sampleNum - 1;
+	}
+	void AddHybridPasses(ResourceHandle cumulativeRender) {
+		ResourceHandle cpuSamples = renderGraph.ImportTexture("CpuSamples", cpuSampleTexture.get());
+		cpuSampleResource = cpuSamples;
+
+		cpuMarchPass = &renderGraph.AddPass("CpuMarch", [this](RenderGraph&) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			cpuRenderer->RenderSample(splitRow, height, GetSampleIndex());
+			measuredCpuSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			measuredGpuRows = splitRow;
+			measuredCpuRows = height - splitRow;
+			gpuTimerPending = true;
+
+			const float* rows = cpuRenderer->GetAccumulation().data() + (size_t)splitRow * width * 4;
+			glTextureSubImage2D(cpuSampleTexture->GetID(), 0, 0, splitRow, width, height - splitRow, GL_RGBA, GL_FLOAT, rows);
+		})
+			.Write(cpuSamples, Access::TextureTransfer);
+		samplePasses.push_back(cpuMarchPass);
+
+		mergeCpuSamplesPass = &renderGraph.AddPass("MergeCpuSamples", [this](RenderGraph&) {
+			cpuSampleTexture->BindImageTexture(2, GL_READ_ONLY);
+			mergeShader->Use();
+			glDispatchCompute((width + 7) / 8, (height - splitRow + 3) / 4, 1);
+		})
+			.Read(cpuSamples, Access::ImageLoad)
+			.Read(cumulativeRender, Access::ImageLoad)
+			.Write(cumulativeRender, Access::ImageStore);
+		samplePasses.push_back(mergeCpuSamplesPass);
+	}
+	// Debug views and ray statistics need the march to count what rays cost, which plain radiance
+	// renders skip. The CPU kernel renders radiance only and counts nothing, so while counting the
+	// GPU renders the whole image.
+	void UpdateCostCounting() {
+		bool counting = debugView != DebugView::radiance || collectingRayStatistics;
+		renderShader.SetInt("_CountCosts", counting);
+		if (!cpuRenderer) return;
+		cpuMarchPass->SetEnabled(!counting);
+		mergeCpuSamplesPass->SetEnabled(!counting);
+	}
+	// Feeds the previous frame's device times to the controller. By now the GPU share of that frame has
+	// long been submitted, so waiting for its timer rarely blocks. Software rasterizers run the dispatch
+	// inside the call and report next to nothing through the timer, so the submit time bounds it from below.
+	void UpdateHybridSplit() {
+		if (!gpuTimerPending) return;
+		gpuTimerPending = false;
+
+		GLuint64 gpuNanoseconds = 0;
+		glGetQueryObjectui64v(gpuTimerQuery.Get(), GL_QUERY_RESULT, &gpuNanoseconds);
+		double gpuSeconds = std::max(gpuNanoseconds * 1.0e-9, measuredSubmitSeconds);
+		hybridController.Update(measuredGpuRows, gpuSeconds, measuredCpuRows, measuredCpuSeconds);
+	}
+};
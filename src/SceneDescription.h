@@ -0,0 +1,113 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <glm/glm.hpp>
+#include <GLFW/glfw3.h>
+
+#include "Camera.h"
+#include "Volume.h"
+#include "WindowInfo.h"
+
+// Plain text scene file, one "key values..." entry per line and '#' for comments:
+//
+//	resolution 1920 1080
+//	environment HDRIs/puresky.hdr
+//	camera.position 0 0 40
+//	camera.rotation 0 0      (yaw and pitch in degrees, applied like mouse look)
+//	camera.fov 45
+//	volume.min -10 -10 -10
+//	volume.max 10 10 10
+//	volume.steps 20          (march steps per ray)
+//	time 0
+struct SceneDescription {
+	unsigned int width = 1920;
+	unsigned int height = 1080;
+	std::string environmentMapPath = "HDRIs/puresky.hdr";
+
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	glm::vec2 cameraRotation = glm::vec2(0.0f);
+	float cameraYFOV = 45.0f;
+
+	glm::vec3 volumeMin = glm::vec3(-1.0f) * 10.0f;
+	glm::vec3 volumeMax = glm::vec3(1.0f) * 10.0f;
+	float volumeStepCount = 20.0f;
+
+	float time = 0.0f;
+
+	SceneDescription() {}
+	SceneDescription(const std::string& scenePath) {
+		std::ifstream file = std::ifstream(scenePath);
+
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not open scene at path <" << scenePath << ">" << std::endl;
+			glfwTerminate();
+			exit(-1);
+		}
+		std::string line;
+		unsigned int lineNumber = 0;
+		while (std::getline(file, line)) {
+			lineNumber++;
+			line = line.substr(0, line.find('#'));
+
+			std::stringstream stream = std::stringstream(line);
+			std::string key;
+			if (!(stream >> key)) continue;
+
+			if (key == "resolution") stream >> width >> height;
+			else if (key == "environment") stream >> environmentMapPath;
+			else if (key == "camera.position") stream >> cameraPosition.x >> cameraPosition.y >> cameraPosition.z;
+			else if (key == "camera.rotation") stream >> cameraRotation.x >> cameraRotation.y;
+			else if (key == "camera.fov") stream >> cameraYFOV;
+			else if (key == "volume.min") stream >> volumeMin.x >> volumeMin.y >> volumeMin.z;
+			else if (key == "volume.max") stream >> volumeMax.x >> volumeMax.y >> volumeMax.z;
+			else if (key == "volume.steps") stream >> volumeStepCount;
+			else if (key == "time") stream >> time;
+			else std::cout << "WARNING: Unknown key <" << key << "> in scene <" << scenePath << "> line " << lineNumber << std::endl;
+
+			if (stream.fail()) {
+				std::cout << "ERROR: Malformed line " << lineNumber << " in scene <" << scenePath << ">" << std::endl;
+				glfwTerminate();
+				exit(-1);
+			}
+		}
+	}
+	// Writes every key, so the file reproduces this description including command line overrides.
+	bool Save(const std::string& scenePath) {
+		std::ofstream file = std::ofstream(scenePath);
+		if (!file.is_open()) {
+			std::cout << "ERROR: Could not write scene to path <" << scenePath << ">" << std::endl;
+			return false;
+		}
+		file << ToString();
+		return !file.fail();
+	}
+	// The scene file text.
+	std::string ToString() const {
+		std::ostringstream stream;
+		stream.precision(9);
+		stream << "resolution " << width << " " << height << "\n"
+			<< "environment " << environmentMapPath << "\n"
+			<< "camera.position " << cameraPosition.x << " " << cameraPosition.y << " " << cameraPosition.z << "\n"
+			<< "camera.rotation " << cameraRotation.x << " " << cameraRotation.y << "\n"
+			<< "camera.fov " << cameraYFOV << "\n"
+			<< "volume.min " << volumeMin.x << " " << volumeMin.y << " " << volumeMin.z << "\n"
+			<< "volume.max " << volumeMax.x << " " << volumeMax.y << " " << volumeMax.z << "\n"
+			<< "volume.steps " << volumeStepCount << "\n"
+			<< "time " << time << "\n";
+		return stream.str();
+	}
+	Camera CreateCamera(WindowInfo windowInfo) {
+		Camera camera = Camera(cameraYFOV, windowInfo);
+		camera.Translate(cameraPosition);
+		camera.Rotate(cameraRotation.x, glm::vec3(0, 1, 0), Space::global);
+		camera.Rotate(cameraRotation.y, glm::vec3(1, 0, 0), Space::local);
+		return camera;
+	}
+	Volume CreateVolume() {
+		Volume volume = Volume(volumeMin, volumeMax);
+		volume.stepCount = volumeStepCount;
+		return volume;
+	}
+};
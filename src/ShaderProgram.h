@@ -3,62 +3,82 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "GLObject.h"
+#include "Profiler.h"
+
+// Compiling and linking only submit the work; the results are checked on the first Use(). Programs
+// constructed back to back thus compile concurrently on drivers with KHR_parallel_shader_compile,
+// whose default is to use as many compiler threads as they like.
 class ShaderProgram {
 public:
-	ShaderProgram(const const std::string& vertPath, const const std::string& fragPath) {
-		LinkProgram(CompileShader(vertPath, GL_VERTEX_SHADER), CompileShader(fragPath, GL_FRAGMENT_SHADER));
+	ShaderProgram(const std::string& vertPath, const std::string& fragPath, const std::vector<std::string>& defines = {}) {
+		PROFILE_ZONE("Compile shaders");
+		LinkProgram(CompileShader(vertPath, GL_VERTEX_SHADER, defines), CompileShader(fragPath, GL_FRAGMENT_SHADER, defines));
 	}
-	ShaderProgram(const const std::string& computePath) {
-		LinkProgram(CompileShader(computePath, GL_COMPUTE_SHADER));
+	ShaderProgram(const std::string& computePath, const std::vector<std::string>& defines = {}) {
+		PROFILE_ZONE("Compile shaders");
+		LinkProgram(CompileShader(computePath, GL_COMPUTE_SHADER, defines));
 	}
 	void Use() {
-		glUseProgram(shaderProgramID);
+		if (!pendingShaders.empty()) CheckLinked();
+		glUseProgram(program.Get());
 	}
 	static void Unuse() {
 		glUseProgram(0);
 	}
 	void SetMat4(const std::string& uniformName, glm::mat4 value) {
-		unsigned int location = glGetUniformLocation(shaderProgramID, uniformName.c_str());
-		glProgramUniformMatrix4fv(shaderProgramID, location, 1, GL_FALSE, glm::value_ptr(value));
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniformMatrix4fv(program.Get(), location, 1, GL_FALSE, glm::value_ptr(value));
 	}
 	void SetVec3(const std::string& uniformName, glm::vec3 value) {
-		unsigned int location = glGetUniformLocation(shaderProgramID, uniformName.c_str());
-		glProgramUniform3fv(shaderProgramID, location, 1, glm::value_ptr(value));
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform3fv(program.Get(), location, 1, glm::value_ptr(value));
+	}
+	void SetVec2(const std::string& uniformName, glm::vec2 value) {
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform2fv(program.Get(), location, 1, glm::value_ptr(value));
+	}
+	void SetIVec2(const std::string& uniformName, glm::ivec2 value) {
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform2iv(program.Get(), location, 1, glm::value_ptr(value));
 	}
 	void SetFloat(const std::string& uniformName, float value) {
-		unsigned int location = glGetUniformLocation(shaderProgramID, uniformName.c_str());
-		glProgramUniform1f(shaderProgramID, location, value);
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform1f(program.Get(), location, value);
 	}
 	void SetDouble(const std::string& uniformName, double value) {
-		unsigned int location = glGetUniformLocation(shaderProgramID, uniformName.c_str());
-		glProgramUniform1d(shaderProgramID, location, value);
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform1d(program.Get(), location, value);
 	}
 	void SetInt(const std::string& uniformName, int value) {
-		unsigned int location = glGetUniformLocation(shaderProgramID, uniformName.c_str());
-		glProgramUniform1i(shaderProgramID, location, value);
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform1i(program.Get(), location, value);
 	}
 	void SetUnsignedInt(const std::string& uniformName, unsigned int value) {
-		unsigned int location = glGetUniformLocation(shaderProgramID, uniformName.c_str());
-		glProgramUniform1ui(shaderProgramID, location, value);
+		unsigned int location = glGetUniformLocation(program.Get(), uniformName.c_str());
+		glProgramUniform1ui(program.Get(), location, value);
 	}
 	void BindUniformBlock(const std::string& blockName, unsigned int bind) {
-		unsigned int blockIndex = glGetUniformBlockIndex(shaderProgramID, blockName.c_str());
-		glUniformBlockBinding(shaderProgramID, blockIndex, bind);
+		unsigned int blockIndex = glGetUniformBlockIndex(program.Get(), blockName.c_str());
+		glUniformBlockBinding(program.Get(), blockIndex, bind);
 	}
 	void BindStorageBlock(const std::string& blockName, unsigned int bind) {
-		unsigned int blockIndex = glGetProgramResourceIndex(shaderProgramID, GL_SHADER_STORAGE_BLOCK, blockName.c_str());
-		glShaderStorageBlockBinding(shaderProgramID, blockIndex, bind);
+		unsigned int blockIndex = glGetProgramResourceIndex(program.Get(), GL_SHADER_STORAGE_BLOCK, blockName.c_str());
+		glShaderStorageBlockBinding(program.Get(), blockIndex, bind);
 	}
 private:
-	unsigned int shaderProgramID;
+	ProgramObject program;
+	// Shaders whose compile status has not been checked yet, with their paths for the error message.
+	std::vector<std::pair<ShaderObject, std::string>> pendingShaders;
 private:
-	unsigned int CompileShader(const std::string& filePath, GLenum type) {
+	unsigned int CompileShader(const std::string& filePath, GLenum type, const std::vector<std::string>& defines) {
 		if (!(type == GL_VERTEX_SHADER || type == GL_FRAGMENT_SHADER || type == GL_COMPUTE_SHADER)) {
 			std::cout << "ERROR: Cannot compile shader of type <" << std::to_string(type) << ">" << std::endl;
 			glfwTerminate();
@@ -74,13 +94,19 @@ private:
 			exit(-1);
 		}
 		stringstream << file.rdbuf();
-		const std::string shaderContents = stringstream.str();
+		std::string shaderContents = stringstream.str();
+
+		// Defines go right after the #version line, which must stay first.
+		std::string defineLines;
+		for (const std::string& define : defines) defineLines += "#define " + define + "\n";
+		size_t versionEnd = shaderContents.find('\n');
+		shaderContents.insert(versionEnd == std::string::npos ? shaderContents.size() : versionEnd + 1, defineLines);
 
 		unsigned int shader = glCreateShader(type);
 		const char* shaderContentsCString = shaderContents.c_str(); // glShaderSource() requires a const double pointer thingy.
 		glShaderSource(shader, 1, &shaderContentsCString, NULL);
 		glCompileShader(shader);
-		ShaderCompilationErrorCheck(shader, filePath);
+		pendingShaders.push_back(std::make_pair(ShaderObject(shader), filePath));
 
 		file.close();
 
@@ -88,26 +114,29 @@ private:
 
 	}
 	void LinkProgram(unsigned int vertShader, unsigned int fragShader) {
-		shaderProgramID = glCreateProgram();
+		program.Reset(glCreateProgram());
+		unsigned int shaderProgramID = program.Get();
 
 		glAttachShader(shaderProgramID, vertShader);
 		glAttachShader(shaderProgramID, fragShader);
 
 		glLinkProgram(shaderProgramID);
-		ProgramLinkingErrorCheck(shaderProgramID);
-
-		glDeleteShader(vertShader);
-		glDeleteShader(fragShader);
 	}
 	void LinkProgram(unsigned int computeShader) {
-		shaderProgramID = glCreateProgram();
+		program.Reset(glCreateProgram());
+		unsigned int shaderProgramID = program.Get();
 
 		glAttachShader(shaderProgramID, computeShader);
 
 		glLinkProgram(shaderProgramID);
-		ProgramLinkingErrorCheck(shaderProgramID);
+	}
+	// Waits for the driver to finish compiling and linking, and exits on errors.
+	void CheckLinked() {
+		PROFILE_ZONE("Wait for shader link");
+		for (std::pair<ShaderObject, std::string>& shader : pendingShaders) ShaderCompilationErrorCheck(shader.first.Get(), shader.second);
+		ProgramLinkingErrorCheck(program.Get());
 
-		glDeleteShader(computeShader);
+		pendingShaders.clear();
 	}
 	void ShaderCompilationErrorCheck(unsigned int shader, const std::string filePath) {
 		int success;
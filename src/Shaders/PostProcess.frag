@@ -1,8 +1,11 @@
-#version 460 core
+#version 450 core
 
 vec3 ACESFilm(vec3 x);
+vec3 Heatmap(float value);
 
-uniform sampler2D finalRenderTexture;
+uniform sampler2D cumulativeRenderTexture;
+// Debug views: the count shown as white. 0 while presenting radiance.
+uniform float _HeatmapScale;
 
 in vec3 fragPos;
 out vec4 FragColor;
@@ -11,9 +14,10 @@ out vec4 FragColor;
 void main(){
 	vec2 uv = (fragPos.xy + 1.0) / 2.0;
 	
-    vec3 color = textureLod(finalRenderTexture, uv, 0.0).rgb;
+    vec4 cumulated = textureLod(cumulativeRenderTexture, uv, 0.0);
+    vec3 color = cumulated.rgb / max(cumulated.a, 1.0);
 
-	FragColor = vec4(ACESFilm(color), 1.0);
+	FragColor = vec4(_HeatmapScale > 0.0 ? Heatmap(color.r / _HeatmapScale) : ACESFilm(color), 1.0);
 }
 
 
@@ -25,4 +29,13 @@ vec3 ACESFilm(vec3 x)
     float d = 0.59;
     float e = 0.14;
     return clamp((x*(a*x+b))/(x*(c*x+d)+e), 0.0, 1.0);
+}
+// Debug view counts: black at 0 through blue, green and yellow to white at 1, and magenta above, like ImageMetrics::Heatmap().
+vec3 Heatmap(float value)
+{
+    const vec3 stops[5] = vec3[5](vec3(0.0), vec3(0.1, 0.2, 1.0), vec3(0.0, 0.8, 0.3), vec3(1.0, 0.9, 0.0), vec3(1.0));
+    if (value > 1.0) return vec3(1.0, 0.0, 1.0);
+    float position = max(value, 0.0) * 4.0;
+    int stop = min(int(position), 3);
+    return mix(stops[stop], stops[stop + 1], position - float(stop));
 }
\ No newline at end of file
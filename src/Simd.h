@@ -0,0 +1,211 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// SoA packet types shared by the CPU kernels. Every type exposes the same operators and free
+// functions, so a kernel written once as a template over the packet type compiles to scalar,
+// AVX2 (8 lanes) or AVX-512 (16 lanes) code. The wide types only exist in translation units
+// built with the matching instruction set enabled.
+//
+// Kernels instantiated in those translation units should stick to these packet types and plain
+// float math. Shared inline helpers (glm operators, static initializers) may be emitted with
+// wide instructions there and then picked by the linker for every caller.
+
+struct Mask1 {
+	bool v;
+};
+struct Float1 {
+	static const int width = 1;
+	typedef Mask1 Mask;
+
+	float v;
+
+	Float1() {}
+	Float1(float v) : v(v) {}
+
+	static Float1 Load(const float* p) { return Float1(p[0]); }
+	static Float1 LoadBytes(const uint8_t* p) { return Float1((float)p[0]); }
+	void Store(float* p) const { p[0] = v; }
+	static Float1 Ramp() { return Float1(0.0f); }
+	float Lane(int) const { return v; }
+};
+inline Float1 operator+(Float1 a, Float1 b) { return Float1(a.v + b.v); }
+inline Float1 operator-(Float1 a, Float1 b) { return Float1(a.v - b.v); }
+inline Float1 operator*(Float1 a, Float1 b) { return Float1(a.v * b.v); }
+inline Float1 operator/(Float1 a, Float1 b) { return Float1(a.v / b.v); }
+inline Float1 operator-(Float1 a) { return Float1(-a.v); }
+inline Mask1 operator<(Float1 a, Float1 b) { return Mask1{ a.v < b.v }; }
+inline Mask1 operator<=(Float1 a, Float1 b) { return Mask1{ a.v <= b.v }; }
+inline Mask1 operator>(Float1 a, Float1 b) { return Mask1{ a.v > b.v }; }
+inline Mask1 operator>=(Float1 a, Float1 b) { return Mask1{ a.v >= b.v }; }
+inline Mask1 operator&(Mask1 a, Mask1 b) { return Mask1{ a.v && b.v }; }
+inline Mask1 operator|(Mask1 a, Mask1 b) { return Mask1{ a.v || b.v }; }
+inline Mask1 AndNot(Mask1 a, Mask1 b) { return Mask1{ !a.v && b.v }; }
+inline bool Any(Mask1 m) { return m.v; }
+inline int MaskBits(Mask1 m) { return m.v ? 1 : 0; }
+inline Float1 Select(Mask1 m, Float1 a, Float1 b) { return m.v ? a : b; }
+// GLSL min/max semantics: NaN in the second operand yields the first.
+inline Float1 Min(Float1 a, Float1 b) { return Float1(b.v < a.v ? b.v : a.v); }
+inline Float1 Max(Float1 a, Float1 b) { return Float1(b.v > a.v ? b.v : a.v); }
+inline Float1 Floor(Float1 a) { return Float1(std::floor(a.v)); }
+inline Float1 Abs(Float1 a) { return Float1(std::fabs(a.v)); }
+inline Float1 Sqrt(Float1 a) { return Float1(std::sqrt(a.v)); }
+inline Float1 FMA(Float1 a, Float1 b, Float1 c) { return Float1(a.v * b.v + c.v); }
+// 2^n for integer valued n in the normal exponent range.
+inline Float1 Pow2i(Float1 n) {
+	uint32_t bits = (uint32_t)((int32_t)n.v + 127) << 23;
+	float result;
+	memcpy(&result, &bits, 4);
+	return Float1(result);
+}
+
+#if defined(__AVX2__)
+struct Mask8 {
+	__m256 v;
+};
+struct Float8 {
+	static const int width = 8;
+	typedef Mask8 Mask;
+
+	__m256 v;
+
+	Float8() {}
+	Float8(__m256 v) : v(v) {}
+	Float8(float f) : v(_mm256_set1_ps(f)) {}
+
+	static Float8 Load(const float* p) { return Float8(_mm256_loadu_ps(p)); }
+	static Float8 LoadBytes(const uint8_t* p) { return Float8(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)))); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+	static Float8 Ramp() { return Float8(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)); }
+	float Lane(int i) const {
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, v);
+		return lanes[i];
+	}
+};
+inline Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline Mask8 operator<(Float8 a, Float8 b) { return Mask8{ _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline Mask8 operator<=(Float8 a, Float8 b) { return Mask8{ _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline Mask8 operator>(Float8 a, Float8 b) { return Mask8{ _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline Mask8 operator>=(Float8 a, Float8 b) { return Mask8{ _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline Mask8 operator&(Mask8 a, Mask8 b) { return Mask8{ _mm256_and_ps(a.v, b.v) }; }
+inline Mask8 operator|(Mask8 a, Mask8 b) { return Mask8{ _mm256_or_ps(a.v, b.v) }; }
+inline Mask8 AndNot(Mask8 a, Mask8 b) { return Mask8{ _mm256_andnot_ps(a.v, b.v) }; }
+inline bool Any(Mask8 m) { return _mm256_movemask_ps(m.v) != 0; }
+inline int MaskBits(Mask8 m) { return _mm256_movemask_ps(m.v); }
+inline Float8 Select(Mask8 m, Float8 a, Float8 b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+inline Float8 Min(Float8 a, Float8 b) { return _mm256_min_ps(b.v, a.v); }
+inline Float8 Max(Float8 a, Float8 b) { return _mm256_max_ps(b.v, a.v); }
+inline Float8 Floor(Float8 a) { return _mm256_floor_ps(a.v); }
+inline Float8 Abs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline Float8 Sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+inline Float8 FMA(Float8 a, Float8 b, Float8 c) { return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v); }
+inline Float8 Pow2i(Float8 n) {
+	__m256i exponent = _mm256_add_epi32(_mm256_cvttps_epi32(n.v), _mm256_set1_epi32(127));
+	return _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+}
+#endif
+
+#if defined(__AVX512F__)
+struct Mask16 {
+	__mmask16 v;
+};
+struct Float16 {
+	static const int width = 16;
+	typedef Mask16 Mask;
+
+	__m512 v;
+
+	Float16() {}
+	Float16(__m512 v) : v(v) {}
+	Float16(float f) : v(_mm512_set1_ps(f)) {}
+
+	static Float16 Load(const float* p) { return Float16(_mm512_loadu_ps(p)); }
+	static Float16 LoadBytes(const uint8_t* p) { return Float16(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)p)))); }
+	void Store(float* p) const { _mm512_storeu_ps(p, v); }
+	static Float16 Ramp() { return Float16(_mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)); }
+	float Lane(int i) const {
+		alignas(64) float lanes[16];
+		_mm512_store_ps(lanes, v);
+		return lanes[i];
+	}
+};
+inline Float16 operator+(Float16 a, Float16 b) { return _mm512_add_ps(a.v, b.v); }
+inline Float16 operator-(Float16 a, Float16 b) { return _mm512_sub_ps(a.v, b.v); }
+inline Float16 operator*(Float16 a, Float16 b) { return _mm512_mul_ps(a.v, b.v); }
+inline Float16 operator/(Float16 a, Float16 b) { return _mm512_div_ps(a.v, b.v); }
+inline Float16 operator-(Float16 a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+inline Mask16 operator<(Float16 a, Float16 b) { return Mask16{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+inline Mask16 operator<=(Float16 a, Float16 b) { return Mask16{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; }
+inline Mask16 operator>(Float16 a, Float16 b) { return Mask16{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+inline Mask16 operator>=(Float16 a, Float16 b) { return Mask16{ _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+inline Mask16 operator&(Mask16 a, Mask16 b) { return Mask16{ (__mmask16)(a.v & b.v) }; }
+inline Mask16 operator|(Mask16 a, Mask16 b) { return Mask16{ (__mmask16)(a.v | b.v) }; }
+inline Mask16 AndNot(Mask16 a, Mask16 b) { return Mask16{ (__mmask16)(~a.v & b.v) }; }
+inline bool Any(Mask16 m) { return m.v != 0; }
+inline int MaskBits(Mask16 m) { return m.v; }
+inline Float16 Select(Mask16 m, Float16 a, Float16 b) { return _mm512_mask_blend_ps(m.v, b.v, a.v); }
+inline Float16 Min(Float16 a, Float16 b) { return _mm512_min_ps(b.v, a.v); }
+inline Float16 Max(Float16 a, Float16 b) { return _mm512_max_ps(b.v, a.v); }
+inline Float16 Floor(Float16 a) { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+inline Float16 Abs(Float16 a) { return _mm512_abs_ps(a.v); }
+inline Float16 Sqrt(Float16 a) { return _mm512_sqrt_ps(a.v); }
+inline Float16 FMA(Float16 a, Float16 b, Float16 c) { return _mm512_add_ps(_mm512_mul_ps(a.v, b.v), c.v); }
+inline Float16 Pow2i(Float16 n) {
+	__m512i exponent = _mm512_add_epi32(_mm512_cvttps_epi32(n.v), _mm512_set1_epi32(127));
+	return _mm512_castsi512_ps(_mm512_slli_epi32(exponent, 23));
+}
+#endif
+
+// Operations built from the primitives above, identical for every packet type.
+
+template<class F> F Fract(F x) {
+	return x - Floor(x);
+}
+// GLSL mod(): x - y * floor(x / y).
+template<class F> F Mod(F x, float y) {
+	return x - F(y) * Floor(x / F(y));
+}
+// GLSL step(edge, x).
+template<class F> F Step(F edge, F x) {
+	return Select(x < edge, F(0.0f), F(1.0f));
+}
+template<class F> F Clamp(F x, float lo, float hi) {
+	return Min(Max(x, F(lo)), F(hi));
+}
+// Stores a, b and c lane by lane as a0 b0 c0 a1 b1 c1 ..., e.g. planar channels as RGB pixels.
+template<class F> void StoreInterleaved3(float* p, F a, F b, F c) {
+	float lanes[3][F::width];
+	a.Store(lanes[0]);
+	b.Store(lanes[1]);
+	c.Store(lanes[2]);
+	for (int i = 0; i < F::width; i++) {
+		p[3 * i + 0] = lanes[0][i];
+		p[3 * i + 1] = lanes[1][i];
+		p[3 * i + 2] = lanes[2][i];
+	}
+}
+// Cephes style expf, accurate to a couple of ulps over the normal range.
+template<class F> F Exp(F x) {
+	x = Clamp(x, -87.0f, 88.0f);
+	F n = Floor(x * F(1.44269504088896341f) + F(0.5f));
+	F r = x - n * F(0.693359375f) + n * F(2.12194440e-4f);
+
+	F p = F(1.9875691500e-4f);
+	p = p * r + F(1.3981999507e-3f);
+	p = p * r + F(8.3334519073e-3f);
+	p = p * r + F(4.1665795894e-2f);
+	p = p * r + F(1.6666665459e-1f);
+	p = p * r + F(5.0000001201e-1f);
+
+	return (p * r * r + r + F(1.0f)) * Pow2i(n);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+#if defined(_MSC_VER)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Where to write a file that is then renamed to path. The name carries the process id, so processes
+// writing the same file at once, like render farm workers building the same cache, never write
+// into each other's temporary file.
+inline std::string GetTemporaryPath(const std::string& path) {
+#if defined(_MSC_VER)
+	int processId = _getpid();
+#else
+	int processId = (int)getpid();
+#endif
+	return path + "." + std::to_string(processId) + ".tmp";
+}
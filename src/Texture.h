@@ -6,12 +6,17 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <algorithm>
 
+#include "GLObject.h"
+#include "Profiler.h"
+#include "EnvironmentCache.h"
+
+// A 2D texture with immutable storage, deleted with the object. Move-only, so it is held by value
+// or through a unique_ptr.
 struct Texture {
 public:
 	Texture(const std::string& texturePath, aiTextureType type) {
-		glGenTextures(1, &textureID);
-
 		int width, height, numChannels;
 
 		unsigned char* data = stbi_load(texturePath.c_str(), &width, &height, &numChannels, 0);
@@ -23,97 +28,95 @@ public:
 			exit(-1);
 		}
 
-		GLenum inFormat = GL_RED, outFormat = GL_RED;
+		GLenum internalFormat = GL_R8, pixelFormat = GL_RED;
 
-		if (numChannels == 3) {
-			if (type == aiTextureType_DIFFUSE) inFormat = GL_SRGB;
-			else inFormat = GL_RGB;
-			outFormat = GL_RGB;
+		if (numChannels == 2) {
+			internalFormat = GL_RG8;
+			pixelFormat = GL_RG;
+		}
+		else if (numChannels == 3) {
+			if (type == aiTextureType_DIFFUSE) internalFormat = GL_SRGB8;
+			else internalFormat = GL_RGB8;
+			pixelFormat = GL_RGB;
 		}
 		else if (numChannels == 4) {
-			if (type == aiTextureType_DIFFUSE) inFormat = GL_SRGB_ALPHA;
-			else inFormat = GL_RGBA;
-			outFormat = GL_RGBA;
+			if (type == aiTextureType_DIFFUSE) internalFormat = GL_SRGB8_ALPHA8;
+			else internalFormat = GL_RGBA8;
+			pixelFormat = GL_RGBA;
 		}
 
-		this->width = width;
-		this->height = height;
-		this->inFormat = inFormat;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, inFormat, width, height, 0, outFormat, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		CreateStorage(width, height, GetMipLevelCount(width, height), internalFormat, GL_REPEAT);
+		// Rows of one to three byte texels are tightly packed.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(texture.Get(), 0, 0, 0, width, height, pixelFormat, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateTextureMipmap(texture.Get());
 
-		glBindTexture(GL_TEXTURE_2D, 0);
 		stbi_image_free(data);
 	}
-	Texture(const std::string& hdrTexturePath) {
-		glGenTextures(1, &textureID);
-
-		stbi_set_flip_vertically_on_load(true);
-
-		int width, height, numChannels;
-		float* data = stbi_loadf(hdrTexturePath.c_str(), &width, &height, &numChannels, 0);
-
-		if (!data) {
-			std::cout << "ERROR: Could not load enviroment map with path <" << hdrTexturePath << ">" << std::endl;
+	Texture(const std::string& hdrTexturePath, EnvironmentFormat format) {
+		PROFILE_ZONE("Load environment map");
+		EnvironmentMapData data;
+		if (!EnvironmentCache::Load(hdrTexturePath, format, data)) {
 			glfwTerminate();
 			exit(-1);
 		}
-		this->width = width;
-		this->height = height;
-		inFormat = GL_RGB32F;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, data);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		stbi_image_free(data);
-
-		stbi_set_flip_vertically_on_load(false);
+		CreateStorage(data.levels[0].width, data.levels[0].height, (int)data.levels.size(), data.GetInternalFormat(), GL_CLAMP_TO_EDGE);
+		for (size_t level = 0; level < data.levels.size(); level++) {
+			data.UploadRows(texture.Get(), level, 0, data.levels[level].height, data.levels[level].data);
+		}
 	}
-	Texture(unsigned int width, unsigned int height) {
-		this->width = width;
-		this->height = height;
-		inFormat = GL_RGBA32F;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glBindTexture(GL_TEXTURE_2D, 0);
+	// Storage without contents, to be filled in with glTextureSubImage2D(). Filtered linearly, and
+	// trilinearly with more than one level.
+	Texture(unsigned int width, unsigned int height, int levelCount, GLenum internalFormat, GLint wrap) {
+		CreateStorage(width, height, levelCount, internalFormat, wrap);
+	}
+	// A render target: one level, written by image stores and read back or sampled 1:1.
+	Texture(unsigned int width, unsigned int height, GLenum internalFormat = GL_RGBA32F) {
+		CreateStorage(width, height, 1, internalFormat, GL_REPEAT);
 	}
 	unsigned int GetID() {
-		return textureID;
+		return texture.Get();
+	}
+	unsigned int GetWidth() {
+		return width;
+	}
+	unsigned int GetHeight() {
+		return height;
+	}
+	GLenum GetFormat() {
+		return inFormat;
 	}
 	void BindImageTexture(unsigned int bindUnit, GLenum access) {
-		glBindImageTexture(bindUnit, textureID, 0, GL_FALSE, 0, access, inFormat);
+		glBindImageTexture(bindUnit, texture.Get(), 0, GL_FALSE, 0, access, inFormat);
+	}
+	// Levels of a full mip chain down to 1x1.
+	static int GetMipLevelCount(unsigned int width, unsigned int height) {
+		int levelCount = 1;
+		for (unsigned int size = std::max(width, height); size > 1; size /= 2) levelCount++;
+		return levelCount;
 	}
 private:
-	unsigned int textureID;
+	TextureObject texture;
 
 	unsigned int width;
 	unsigned int height;
 
 	GLenum inFormat;
+private:
+	void CreateStorage(unsigned int width, unsigned int height, int levelCount, GLenum internalFormat, GLint wrap) {
+		this->width = width;
+		this->height = height;
+		inFormat = internalFormat;
+
+		GLuint textureID;
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		texture.Reset(textureID);
+		glTextureStorage2D(textureID, levelCount, internalFormat, width, height);
+
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, wrap);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, wrap);
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+
+#include "Profiler.h"
+
+// Work-stealing scheduler for a fixed set of tiles that is run once per frame. The time spent on
+// every tile is recorded, and the next frame deals the tiles out largest-first so the expensive
+// cloud tiles start early and the cheap sky tiles fill the gaps at the end. Each thread owns a
+// queue; a thread that runs dry takes the next tile from another thread's queue.
+class TileScheduler {
+public:
+	struct ThreadStats {
+		unsigned int tileCount = 0;
+		unsigned int stealCount = 0;
+		double busySeconds = 0.0;
+		// Fraction of the last frame this thread spent inside tiles.
+		double utilization = 0.0;
+	};
+public:
+	// A thread count of zero uses every hardware thread. The calling thread takes part as thread 0.
+	TileScheduler(size_t tileCount, unsigned int threadCount = 0) {
+		if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		costs.resize(tileCount, 0.0);
+		order.reserve(tileCount);
+		stats.resize(threadCount);
+		for (unsigned int i = 0; i < threadCount; i++) queues.emplace_back(new TileQueue());
+		for (unsigned int i = 1; i < threadCount; i++) threads.emplace_back(&TileScheduler::WorkerLoop, this, i);
+	}
+	~TileScheduler() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		startCondition.notify_all();
+		for (std::thread& thread : threads) thread.join();
+	}
+	TileScheduler(const TileScheduler&) = delete;
+	TileScheduler& operator=(const TileScheduler&) = delete;
+
+	// Runs task(tileIndex) for every tile and returns once all of them are done.
+	void Run(const std::function<void(size_t)>& task) {
+		Run(0, costs.size(), task);
+	}
+	// Same for the tiles in [begin, end) only.
+	void Run(size_t begin, size_t end, const std::function<void(size_t)>& task) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		order.clear();
+		for (size_t i = begin; i < end; i++) order.push_back(i);
+		std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+		// Dealt round robin, so every queue is sorted largest-first as well.
+		for (size_t i = 0; i < order.size(); i++) queues[i % queues.size()]->tiles.push_back(order[i]);
+		for (ThreadStats& threadStats : stats) threadStats = ThreadStats();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			currentTask = &task;
+			finishedCount = 0;
+			generation++;
+		}
+		startCondition.notify_all();
+
+		Work(0);
+
+		PROFILE_ZONE("Wait for tile workers");
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this]() { return finishedCount == threads.size(); });
+		currentTask = nullptr;
+
+		frameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		for (ThreadStats& threadStats : stats) threadStats.utilization = frameSeconds > 0.0 ? threadStats.busySeconds / frameSeconds : 0.0;
+	}
+	unsigned int GetThreadCount() {
+		return (unsigned int)queues.size();
+	}
+	// Per thread statistics of the last Run().
+	const std::vector<ThreadStats>& GetThreadStats() {
+		return stats;
+	}
+	double GetFrameSeconds() {
+		return frameSeconds;
+	}
+	// Measured seconds per tile in the last Run(), used as the prediction for the next one.
+	const std::vector<double>& GetTileCosts() {
+		return costs;
+	}
+private:
+	// Padded so neighbouring queues do not share a cache line.
+	struct TileQueue {
+		std::mutex mutex;
+		std::deque<size_t> tiles;
+		char padding[64];
+	};
+
+	void WorkerLoop(unsigned int index) {
+		Profiler::SetThreadName("Tile worker " + std::to_string(index));
+		unsigned int seenGeneration = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				startCondition.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+				if (stopping) return;
+				seenGeneration = generation;
+			}
+			Work(index);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finishedCount++;
+			}
+			doneCondition.notify_one();
+		}
+	}
+	// Tiles are never added during a frame, so once every queue is empty this thread is done.
+	void Work(unsigned int index) {
+		ThreadStats& threadStats = stats[index];
+		size_t tile;
+		while (true) {
+			if (!Pop(index, tile)) {
+				if (!Steal(index, tile)) return;
+				threadStats.stealCount++;
+			}
+			PROFILE_ZONE("Tile");
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			(*currentTask)(tile);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			costs[tile] = seconds;
+			threadStats.busySeconds += seconds;
+			threadStats.tileCount++;
+		}
+	}
+	bool Pop(unsigned int index, size_t& tile) {
+		TileQueue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tiles.empty()) return false;
+		tile = queue.tiles.front();
+		queue.tiles.pop_front();
+		return true;
+	}
+	// Takes the victim's next (largest remaining) tile, keeping the global order close to largest-first.
+	bool Steal(unsigned int index, size_t& tile) {
+		for (size_t i = 1; i < queues.size(); i++) {
+			if (Pop((unsigned int)((index + i) % queues.size()), tile)) return true;
+		}
+		return false;
+	}
+private:
+	std::vector<std::unique_ptr<TileQueue>> queues;
+	std::vector<std::thread> threads;
+	std::vector<ThreadStats> stats;
+
+	std::vector<double> costs;
+	std::vector<size_t> order;
+	double frameSeconds = 0.0;
+
+	std::mutex mutex;
+	std::condition_variable startCondition, doneCondition;
+	const std::function<void(size_t)>* currentTask = nullptr;
+	unsigned int generation = 0;
+	size_t finishedCount = 0;
+	bool stopping = false;
+};
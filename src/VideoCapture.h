@@ -0,0 +1,207 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+
+#if !defined(_MSC_VER)
+#include <csignal>
+#endif
+
+#include "Renderer.h"
+#include "ReadbackRing.h"
+
+enum class VideoFormat {
+	// YUV4MPEG2, 4:2:0 BT.709 limited range: what ffmpeg and most players read from a pipe without options.
+	y4m,
+	// Packed 8 bit RGB top row first, e.g. ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH.
+	rgb
+};
+
+// Streams every rendered frame, tonemapped as it is presented, into a file or the standard input of
+// a command. Frames come through a readback ring of its own, and a writer thread converts and
+// writes them, so the render thread never waits on the GPU or on the consumer. The ring is the only
+// frame storage: when the consumer falls behind, all its slots fill up and further frames are dropped
+// and counted until one is free again.
+class VideoCapture {
+public:
+	VideoCapture(Renderer& renderer, unsigned int queueDepth) :
+		renderer(renderer),
+		ring(queueDepth)
+	{
+	}
+	~VideoCapture() {
+		Close();
+	}
+	VideoCapture(const VideoCapture&) = delete;
+	VideoCapture& operator=(const VideoCapture&) = delete;
+
+	// destination is a path, or a command after a '|' that reads the stream from its standard input.
+	bool Open(const std::string& destination, VideoFormat format, unsigned int framesPerSecond) {
+		this->format = format;
+		isPipe = !destination.empty() && destination[0] == '|';
+		if (isPipe) {
+#if defined(_MSC_VER)
+			output = _popen(destination.c_str() + 1, "wb");
+#else
+			// A consumer that exits early must not take the renderer down with it.
+			signal(SIGPIPE, SIG_IGN);
+			output = popen(destination.c_str() + 1, "w");
+#endif
+		}
+		else output = fopen(destination.c_str(), "wb");
+
+		if (!output) {
+			std::cout << "ERROR: Could not open video output <" << destination << ">" << std::endl;
+			return false;
+		}
+		if (format == VideoFormat::y4m) {
+			std::string header = "YUV4MPEG2 W" + std::to_string(renderer.GetWidth()) + " H" + std::to_string(renderer.GetHeight())
+				+ " F" + std::to_string(framesPerSecond) + ":1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+			fwrite(header.data(), 1, header.size(), output);
+		}
+		writerThread = std::thread(&VideoCapture::WriterLoop, this);
+		return true;
+	}
+	// Call once per rendered frame.
+	void Update() {
+		ring.Poll();
+		if (!output || failed.load()) return;
+
+		bool queued = renderer.ReadTonemappedAsync(ring, [this](unsigned int slot, const void* data, size_t) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				frames.push_back(Frame{ slot, (const unsigned char*)data });
+			}
+			frameCondition.notify_one();
+		});
+		if (!queued) droppedCount++;
+	}
+	// Writes every queued frame and closes the output. Render thread only.
+	void Close() {
+		if (!output) return;
+
+		ring.Finish();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		frameCondition.notify_one();
+		writerThread.join();
+
+#if defined(_MSC_VER)
+		if (isPipe) _pclose(output);
+#else
+		if (isPipe) pclose(output);
+#endif
+		else fclose(output);
+		output = nullptr;
+	}
+	unsigned int GetWrittenCount() {
+		return writtenCount.load();
+	}
+	// Frames rendered while every slot of the ring was still waiting for the consumer.
+	unsigned int GetDroppedCount() {
+		return droppedCount;
+	}
+private:
+	struct Frame {
+		unsigned int slot;
+		const unsigned char* pixels;
+	};
+
+	Renderer& renderer;
+	ReadbackRing ring;
+	VideoFormat format = VideoFormat::y4m;
+	FILE* output = nullptr;
+	bool isPipe = false;
+
+	std::thread writerThread;
+	std::deque<Frame> frames;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable frameCondition;
+
+	unsigned int droppedCount = 0;
+	std::atomic<unsigned int> writtenCount{ 0 };
+	std::atomic<bool> failed{ false };
+private:
+	void WriterLoop() {
+		std::vector<unsigned char> bytes;
+		while (true) {
+			Frame frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				frameCondition.wait(lock, [this]() { return stopping || !frames.empty(); });
+				if (frames.empty()) return;
+				frame = frames.front();
+				frames.pop_front();
+			}
+			// Converted into a buffer of our own, so the slot is back in the ring before a slow consumer is written to.
+			if (!failed.load()) Convert(frame.pixels, bytes);
+			ring.Release(frame.slot);
+			if (failed.load()) continue;
+
+			if (fwrite(bytes.data(), 1, bytes.size(), output) != bytes.size()) {
+				std::cout << "ERROR: Video consumer stopped accepting frames" << std::endl;
+				failed.store(true);
+				continue;
+			}
+			writtenCount++;
+		}
+	}
+	// pixels: RGBA8 bottom row first, as read back.
+	void Convert(const unsigned char* pixels, std::vector<unsigned char>& bytes) {
+		unsigned int width = renderer.GetWidth(), height = renderer.GetHeight();
+
+		if (format == VideoFormat::rgb) {
+			bytes.resize((size_t)width * height * 3);
+			unsigned char* out = bytes.data();
+			for (unsigned int y = 0; y < height; y++) {
+				const unsigned char* row = pixels + (size_t)(height - 1 - y) * width * 4;
+				for (unsigned int x = 0; x < width; x++, out += 3) {
+					out[0] = row[x * 4 + 0];
+					out[1] = row[x * 4 + 1];
+					out[2] = row[x * 4 + 2];
+				}
+			}
+			return;
+		}
+
+		// Full resolution luma, then chroma averaged over 2x2 blocks; odd edges repeat the last pixel.
+		unsigned int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+		const char frameHeader[] = "FRAME\n";
+		bytes.resize(6 + (size_t)width * height + (size_t)chromaWidth * chromaHeight * 2);
+		std::copy(frameHeader, frameHeader + 6, bytes.begin());
+
+		unsigned char* luma = bytes.data() + 6;
+		unsigned char* cb = luma + (size_t)width * height;
+		unsigned char* cr = cb + (size_t)chromaWidth * chromaHeight;
+		for (unsigned int y = 0; y < height; y++) {
+			const unsigned char* row = pixels + (size_t)(height - 1 - y) * width * 4;
+			for (unsigned int x = 0; x < width; x++) {
+				const unsigned char* p = row + x * 4;
+				luma[(size_t)y * width + x] = (unsigned char)(((47 * p[0] + 157 * p[1] + 16 * p[2] + 128) >> 8) + 16);
+			}
+		}
+		for (unsigned int cy = 0; cy < chromaHeight; cy++) {
+			unsigned int y0 = cy * 2, y1 = std::min(y0 + 1, height - 1);
+			const unsigned char* row0 = pixels + (size_t)(height - 1 - y0) * width * 4;
+			const unsigned char* row1 = pixels + (size_t)(height - 1 - y1) * width * 4;
+			for (unsigned int cx = 0; cx < chromaWidth; cx++) {
+				unsigned int x0 = cx * 2, x1 = std::min(x0 + 1, width - 1);
+				int rgb[3];
+				for (int c = 0; c < 3; c++) rgb[c] = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+				// BT.709 chroma scaled to 224 levels around 128; the sums above are 4x, hence >> 10.
+				cb[(size_t)cy * chromaWidth + cx] = (unsigned char)((-26 * rgb[0] - 86 * rgb[1] + 112 * rgb[2] + (128 << 10) + 512) >> 10);
+				cr[(size_t)cy * chromaWidth + cx] = (unsigned char)((112 * rgb[0] - 102 * rgb[1] - 10 * rgb[2] + (128 << 10) + 512) >> 10);
+			}
+		}
+	}
+};
@@ -10,4 +10,6 @@ public:
 public:
 	glm::vec3 cornerMin;
 	glm::vec3 cornerMax;
+	// March steps along every ray through the volume, and along every shadow ray.
+	float stepCount = 20.0f;
 };
\ No newline at end of file
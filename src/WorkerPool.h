@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+#include "Profiler.h"
+
+// Background threads that run jobs in submission order. Unlike TileScheduler, which splits one
+// frame over the calling thread and its workers and returns when everything is done, Submit()
+// returns at once, so the render thread can hand work off and carry on.
+class WorkerPool {
+public:
+	typedef std::function<void()> Job;
+public:
+	// A thread count of zero leaves one hardware thread to the caller.
+	WorkerPool(unsigned int threadCount = 0) {
+		if (threadCount == 0) threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		for (unsigned int i = 0; i < threadCount; i++) threads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+	// Finishes every submitted job first.
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobCondition.notify_all();
+		for (std::thread& thread : threads) thread.join();
+	}
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void Submit(Job job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		jobCondition.notify_one();
+	}
+	// Returns once no job is queued or running.
+	void Wait() {
+		PROFILE_ZONE("WorkerPool::Wait");
+		std::unique_lock<std::mutex> lock(mutex);
+		idleCondition.wait(lock, [this]() { return jobs.empty() && runningCount == 0; });
+	}
+	unsigned int GetThreadCount() {
+		return (unsigned int)threads.size();
+	}
+private:
+	std::vector<std::thread> threads;
+	std::deque<Job> jobs;
+	unsigned int runningCount = 0;
+	bool stopping = false;
+
+	std::mutex mutex;
+	std::condition_variable jobCondition;
+	std::condition_variable idleCondition;
+private:
+	void WorkerLoop() {
+		Profiler::SetThreadName("Worker pool");
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			jobCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return;
+
+			Job job = std::move(jobs.front());
+			jobs.pop_front();
+			runningCount++;
+
+			lock.unlock();
+			{
+				PROFILE_ZONE("Job");
+				job();
+			}
+			lock.lock();
+
+			runningCount--;
+			if (jobs.empty() && runningCount == 0) idleCondition.notify_all();
+		}
+	}
+};